@@ -2,6 +2,7 @@
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include "uart.h"
+#include "stdTelemetry.h"
 
 #include "stdThreads.h" 
 
@@ -16,7 +17,7 @@ stdInstantiateThread( mainThread, 1,  Null,   10, 1, &ledder );
 stdThread_t    stdCurrentThread   = &mainThread;
 ThreadPrioQ_t  stdRunQ            = &mainThread;
 
-        static volatile stdThread_t   pingWaiter;
+        static stdInstantiateSignal(  pingDone );
         static volatile uInt32        pingDelay;
         static volatile uInt16        pingPreviousEventTime;
 
@@ -39,12 +40,12 @@ void pingTimer1CAPT()
         DIDR1   = 0;                          // Enable digital input on AIN1
 
         pingDelay = time - pingPreviousEventTime;
-        stdThreadResume(pingWaiter); 
+        stdSignalRaise(&pingDone); 
     }
 }
 
         SIGNAL(TIMER1_CAPT_vect)
-        { pingTimer1CAPT(); }
+        { stdRunISR(pingTimer1CAPT); }
 
     static void pingStart()
     {
@@ -72,6 +73,18 @@ void pingTimer1CAPT()
     static volatile uInt32 maxDelay     = 0;
     
     #define RANGE 32
+
+   /*
+    * Telemetry record sent for each changed ping,
+    * decoded by Tools/telemetry.py --baud 38400 --record 1:ping:IB:delay,scaled
+    * (the UART runs at 38400 bps in the default 8 MHz build)
+    */
+    #define PING_RECORD  1
+
+    typedef struct {
+        uInt32  delay;
+        uInt8   scaled;
+    } PingRecord;
     
     static uInt8 scaledPing()
     {
@@ -121,14 +134,14 @@ int main()
     while (1) {
         stdThreadSleep( stdSECOND/4 );
 
+        stdSignalReset(&pingDone);
         pingStart();
-        pingWaiter = stdCurrentThread;
 
         PORTC ^= (1<<PC5);
         stdThreadSleep( 1 );
         PORTC ^= (1<<PC5);
         
-        stdThreadSuspendSelf();
+        stdSignalWait(&pingDone, stdFOREVER);
         
         stdSemP(&lock);
         if (pingDelay == currentDelay) {
@@ -139,7 +152,14 @@ int main()
             if (maxDelay < pingDelay) { maxDelay = pingDelay; }
             stdSemV(&lock);
             
-            printf_P( PSTR(" PING: %d\r\n"),  scaledPing() );
+            {
+                PingRecord record;
+
+                record.delay  = pingDelay;
+                record.scaled = scaledPing();
+
+                stdTelemetrySend( PING_RECORD, &record, sizeof(record) );
+            }
         }
     }
         
@@ -1,7 +1,7 @@
 
 #include <avr/io.h>
 #include <avr/pgmspace.h>
-#include "uart.h"
+#include "stdUSpi.h"
 
 #include "stdThreads.h" 
 
@@ -14,48 +14,36 @@ stdThread_t    stdCurrentThread   = &mainThread;
 ThreadPrioQ_t  stdRunQ            = &mainThread;
 
 
+/*
+ * The DAC takes its data from the usart in SPI mode,
+ * with SDI on TXD (PD1) and SCK on XCK (PD4):
+ */
 #define DAC_LADC   (1<<PC2)
-#define DAC_SDI    (1<<PC3)
-#define DAC_SCK    (1<<PC4)
-#define DAC_CS     (1<<PC5)
+
+stdInstantiateUSpiDevice( dac, C, PC5, stdUSPI_MODE0, 4000000UL );
 
 
 void dacInit()
 {
-    DDRC  |=  (DAC_LADC | DAC_SDI | DAC_SCK | DAC_CS);
-    
-    PORTC &= ~(DAC_SCK);
-    PORTC |=  (DAC_LADC | DAC_CS);
-}
+    stdUSpiInit();
+    stdUSpiAttach(&dac);
 
-static void wrdac( uInt8 n )
-{
-    for (uInt8 i= 0; i<8; i++) {
-        if ( ((Int8)n)<0 ) {  PORTC |=  (DAC_SDI); }
-                      else {  PORTC &= ~(DAC_SDI); }
-        stdThreadSleep(1);
-        PORTC |=  (DAC_SCK);
-        stdThreadSleep(1);
-        PORTC &= ~(DAC_SCK);
-        stdThreadSleep(1);
-        
-        n<<=1;
-    }
+    DDRC  |=  (DAC_LADC);
+    PORTC |=  (DAC_LADC);
 }
 
 void dacWrite( uInt16 n )
 {
+    uInt8 bytes[2];
+
     n |= (3<<12);
-    PORTC &= ~(DAC_CS);
-    stdThreadSleep(1);
-    wrdac( n>>8 );
-    wrdac( n    );
-    PORTC &= ~(DAC_SDI);
-    stdThreadSleep(1);
-    PORTC |=  (DAC_CS);
-    
+
+    bytes[0]= n >> 8;
+    bytes[1]= n;
+
+    stdUSpiTransfer( &dac, bytes, Null, 2 );
+
     PORTC &= ~(DAC_LADC);
-    stdThreadSleep(1);
     PORTC |=  (DAC_LADC);
 }
 
@@ -0,0 +1,160 @@
+/*
+ *  Module name              : main.c
+ *
+ *  Description              :
+ *
+ *         This example compares deadline misses of fixed priority 
+ *         scheduling against earliest deadline first scheduling, 
+ *         for a simulated periodic workload resembling our projects:
+ *
+ *             display refresh    every 1/64 s   using 31% cpu
+ *             beam strobe        every 1/16 s   using 29% cpu
+ *             sensor sampling    every 1/10 s   using 33% cpu
+ *
+ *         Each job burns a fixed amount of cpu, calibrated at startup.
+ *         With fixed priorities, the threads are given rate monotonic
+ *         priorities. After 10 seconds, the amount of jobs and the 
+ *         amount of deadline misses per thread are shown on the lcd.
+ *
+ *         At a 1 kHz kernel clock, the sensor thread cannot meet its 
+ *         deadline under fixed priorities (its worst case response time
+ *         is about 105 ticks on a period of stdSECOND/10, which is 102 ticks
+ *         since stdSECOND is 1024 ticks), whereas the total utilization
+ *         of 93% is schedulable by EDF, apart from kernel overhead.
+ *
+ *         Build once with the default configuration, and once with
+ *         THREADS_SCHEDULING=EDF (after a make clean, since the kernel
+ *         library must be rebuilt).
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include "stdThreads.h" 
+#include "stdInterrupts.h" 
+
+#include "lcd.h"
+
+/* -------------------------------- Example -------------------------------- */
+
+/*
+ * Forward declarations:
+ */
+void displayF(); 
+void strobeF();
+void sensorF();
+
+/*
+ * Periodic threads, initially idle until
+ * the cpu burn loop has been calibrated.
+ * Priorities are rate monotonic, and are
+ * only used by fixed priority scheduling:
+ */
+stdInstantiateThread( display,         80, displayF,      3, 0, Null );
+stdInstantiateThread( strobe,          80, strobeF,       2, 0, Null );
+stdInstantiateThread( sensor,          80, sensorF,       1, 0, Null );
+
+stdInstantiateThread( mainThread,       1, Null,          4, 1, Null );
+
+/*
+ * Run Queue Initialization:
+ */
+stdThread_t    stdCurrentThread   = &mainThread;
+ThreadPrioQ_t  stdRunQ            = &mainThread;
+
+
+volatile uInt8  burnSink;
+         uInt32 loopsPerTick;
+volatile Bool   running = True;
+
+static void burn( uInt32 loops )
+{
+    while (loops--) {
+        burnSink++;
+    }
+}
+
+/*
+ * Determine the amount of burn loops per kernel clock tick,
+ * by doubling the amount of loops until these take 
+ * at least 64 ticks:
+ */
+static void calibrate()
+{
+    uInt32 loops= 1024;
+    uInt16 elapsed;
+
+    do {
+        uInt16 start= stdTime();
+
+        while (stdTime() == start) {}
+        start++;
+
+        burn(loops);
+        elapsed= stdTime() - start;
+        loops *= 2;
+    } while (elapsed < 64);
+
+    loopsPerTick= (loops/2) / elapsed;
+}
+
+/*
+ * Job statistics:
+ */
+volatile uInt16 displayJobs, strobeJobs, sensorJobs;
+
+static void runPeriodic( uInt16 period, uInt8 load, volatile uInt16 *jobs )
+{
+    uInt32 loops= loopsPerTick * period * load / 100;
+
+    stdThreadWaitPeriod(period);
+
+    while (running) {
+        burn(loops);
+        (*jobs)++;
+        stdThreadWaitPeriod(period);
+    }
+    
+    stdThreadSuspendSelf();
+}
+
+void displayF() { runPeriodic( stdSECOND/64, 31, &displayJobs ); }
+void strobeF()  { runPeriodic( stdSECOND/16, 29, &strobeJobs  ); }
+void sensorF()  { runPeriodic( stdSECOND/10, 33, &sensorJobs  ); }
+
+
+static void printStatistics( uInt8 row, const char *name, stdThread_t thread, uInt16 jobs )
+{
+    lcd_goto_position(row,0);
+    lcd_write_string(name);
+    lcd_write_int16(stdThreadDeadlineMisses(thread));
+    lcd_write_string(PSTR("/"));
+    lcd_write_int16(jobs);
+}
+
+int main()
+{    
+    // Initialize the kernel
+    stdSetup();
+
+    // fire up the LCD
+    lcd_init();
+    lcd_home();
+    
+    calibrate();
+
+    stdThreadResume(&display);
+    stdThreadResume(&strobe);
+    stdThreadResume(&sensor);
+    
+    stdThreadSleep(10*stdSECOND);
+
+    running = False;
+
+    printStatistics( 0, PSTR("display "), &display, displayJobs );
+    printStatistics( 1, PSTR("strobe  "), &strobe,  strobeJobs  );
+    printStatistics( 2, PSTR("sensor  "), &sensor,  sensorJobs  );
+
+    stdThreadSuspendSelf();
+    
+    return 0;
+}
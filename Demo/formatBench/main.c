@@ -0,0 +1,112 @@
+/*
+ *  Module name              : main.c
+ *
+ *  Description              :
+ *
+ *         This example compares stdFormat against avr-libc printf,
+ *         by formatting a typical log line into a buffer a hundred
+ *         times, and showing the average amount of cpu cycles per 
+ *         line on the lcd, as counted by Timer1.
+ *
+ *         Build once with the default configuration, and once with
+ *         FORMAT=PRINTF (after a make local_clean); 'make compare'
+ *         does both, reporting flash (text + data) and static RAM
+ *         (data + bss) of each build with avr-size, and keeping them
+ *         as stdFormat.out and printf.out. Besides the cycle counts 
+ *         on the lcd, compare stack usage of the formatting functions
+ *         in the .su files. Each build only links the formatter that
+ *         it uses.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include <avr/pgmspace.h>
+
+#include "stdThreads.h" 
+#include "stdInterrupts.h" 
+
+#include "lcd.h"
+
+#if defined(BENCH_PRINTF)
+    #include <stdio.h>
+#else
+    #include "stdFormat.h"
+#endif
+
+/* -------------------------------- Example -------------------------------- */
+
+stdInstantiateThread( mainThread,       1, Null,          1, 1, Null );
+
+/*
+ * Run Queue Initialization:
+ */
+stdThread_t    stdCurrentThread   = &mainThread;
+ThreadPrioQ_t  stdRunQ            = &mainThread;
+
+
+#define LINES   100
+
+static char line[40];
+
+/*
+ * Format one line, returning the amount
+ * of cpu cycles that it took:
+ */
+static uInt16 formatLine( uInt16 i )
+{
+    uInt16 cycles;
+
+    stdXDisableInterrupts();
+    {
+        TCNT1= 0;
+
+       #if defined(BENCH_PRINTF)
+        snprintf_P( line, sizeof(line), PSTR("%5u T=%d V=%04x %s\r\n"), i, -(Int)i, 3*i, "ok" );
+       #else
+        stdFormatString_P( line, sizeof(line), PSTR("%5u T=%d V=%04x %s\r\n"), i, -(Int)i, 3*i, "ok" );
+       #endif
+
+        cycles= TCNT1;
+    }
+    stdXEnableInterrupts();
+
+    return cycles;
+}
+
+int main()
+{    
+    uInt32 total= 0;
+    uInt16 i;
+
+    // Initialize the kernel
+    stdSetup();
+
+    // fire up the LCD
+    lcd_init();
+    lcd_home();
+    
+    // Timer1 counting cpu cycles
+    PRR   &= ~(1<<PRTIM1);
+    TCCR1A = 0;
+    TCCR1B = (1<<CS10);
+
+    for (i= 0; i < LINES; i++) {
+        total += formatLine(i);
+    }
+
+   #if defined(BENCH_PRINTF)
+    lcd_write_string(PSTR("printf_P  "));
+   #else
+    lcd_write_string(PSTR("stdFormat "));
+   #endif
+    lcd_write_int16(total / LINES);
+    lcd_write_string(PSTR(" cyc"));
+
+    lcd_line_two();
+    lcd_write_string(PSTR("line: "));
+    lcd_write_int16(LINES-1);
+
+    stdThreadSuspendSelf();
+    
+    return 0;
+}
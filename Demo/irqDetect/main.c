@@ -20,23 +20,28 @@ stdInstantiateSemaphore( print, 1 );
 
 uint16_t interval_start;
 
+stdInstantiateSignal( irqSeen );
+
 void tickerF()
 {
     while (True) {
-        stdThreadSuspendSelf();
+        stdSignalWait(&irqSeen, stdFOREVER);
         stdSemP(&print);
-        printf_P( PSTR("    TOCK at %d\n\r"), interval_start );
+        uart_format_P( PSTR("    TOCK at %d\n\r"), interval_start );
         stdSemV(&print);
     }
 }
 
 
 
-    SIGNAL(INT0_vect)
+    static void irqHandler()
     { 
-        stdThreadResume( &ticker );
+        stdSignalRaise( &irqSeen );
     }
 
+    SIGNAL(INT0_vect)
+    { stdRunISR(irqHandler); }
+
 int main()
 {    
     stdSetup();
@@ -66,7 +71,7 @@ int main()
         }
         
         stdSemP(&print);
-        printf_P( PSTR(" ---\n\r") );
+        uart_format_P( PSTR(" ---\n\r") );
         stdSemV(&print);
     }
         
@@ -10,16 +10,16 @@
  *         that repeatedly counts from 0 to 15 and displays the result
  *         in binary via 4 output pins.
  * 
- *         The producer produces 'tokens' in the token semaphore,
+ *         The producer produces 'tokens' into a token monitor,
  *         to be picked up by either consumer. The producer's
- *         production is also bound by a control semaphore, to 
- *         prevent runaway.
+ *         production is bounded by a maximum amount of available
+ *         tokens, to prevent runaway. Producer and consumers 
+ *         wait on condition variables of the monitor.
  *
  *         All threads print in parallel to their corresponding areas 
- *         on the lcd screen, which needs a lock to avoid unwanted printing
- *         interaction. This lock is created in a locked, or 'held'
- *         state, to be released by the main thread after lcd
- *         initialization is performed.
+ *         of the lcd frame buffer, without locking. A refresher thread
+ *         sends the changed characters to the lcd a number of times 
+ *         per second.
  */
 
 /*--------------------------------- Includes --------------------------------*/
@@ -27,32 +27,18 @@
 #include "stdThreads.h" 
 #include "stdInterrupts.h" 
 
-#include "lcd.h"
+#include "stdLcdFrame.h"
 
 /* ---------------------------------- I/O ---------------------------------- */
 
-/*
- * lcd printing lock. Hold this lock until the lcd is initialized:
- */
-stdInstantiateSemaphore( print, 0 );
-
 void PRINTS(uInt8 row, uint8_t col, const char *s)
 {
-    stdSemP(&print);
-    lcd_goto_position(row,col);
-    lcd_write_string(s);
-    stdSemV(&print);
+    stdLcdWrite_P(row,col,s);
 }
 
 void PRINT(uInt8 row, uint8_t col, const char *s, uInt16 val)
 {
-    stdSemP(&print);
-    lcd_goto_position(row,col);
-    lcd_write_string(s);
-    lcd_write_string(PSTR(": "));
-    lcd_write_int16(val);
-    lcd_write_string(PSTR("  "));
-    stdSemV(&print);
+    stdLcdFormat_P(row,col,PSTR("%S: %u  "),s,val);
 }
 
 /* -------------------------------- Example -------------------------------- */
@@ -93,10 +79,46 @@ ThreadPrioQ_t  stdRunQ            = &mainThread;
 
 
 /*
- * Static global lock creation:
+ * Token monitor: the amount of available tokens
+ * is protected by the token lock, and threads wait
+ * on the respective conditions for changes:
  */
-stdInstantiateSemaphore( tokens,  0 );
-stdInstantiateSemaphore( control, 5 );
+#define MAX_TOKENS  5
+
+static uInt tokens= 0;
+
+stdInstantiateMutex    ( tokenLock );
+stdInstantiateCondition( tokenAvailable, &tokenLock );
+stdInstantiateCondition( spaceAvailable, &tokenLock );
+
+
+static void putToken()
+{
+    stdMutexEnter(&tokenLock);
+    {
+        while (tokens == MAX_TOKENS) {
+            stdCondWait(&spaceAvailable, stdFOREVER);
+        }
+        
+        tokens++;
+        stdCondSignal(&tokenAvailable);
+    }
+    stdMutexExit(&tokenLock);
+}
+
+static void getToken()
+{
+    stdMutexEnter(&tokenLock);
+    {
+        while (tokens == 0) {
+            stdCondWait(&tokenAvailable, stdFOREVER);
+        }
+        
+        tokens--;
+        stdCondSignal(&spaceAvailable);
+    }
+    stdMutexExit(&tokenLock);
+}
 
 
 /*
@@ -125,10 +147,9 @@ void producerF()
     uInt produced= 0;
     
     while (True) {
-        stdSemP(&control);
         produced++;
         PRINT(0,10,PSTR("P "),produced);
-        stdSemV(&tokens);
+        putToken();
    }
 }
 
@@ -137,10 +158,9 @@ void consumer1F()
     uInt consumed= 0;
     
     while (True) {
-        stdSemP(&tokens);
+        getToken();
         consumed++;
         PRINT(1,0,PSTR("C1"),consumed);
-        stdSemV(&control);
     }
 }
 
@@ -149,10 +169,9 @@ void consumer2F()
     uInt consumed= 0;
     
     while (True) {
-        stdSemP(&tokens);
+        getToken();
         consumed++;
         PRINT(1,10,PSTR("C2"),consumed);
-        stdSemV(&control);
     }
 }
 
@@ -183,12 +202,8 @@ int main()
     // Initialize the kernel
     stdSetup();
 
-    // fire up the LCD
-    lcd_init();
-    lcd_home();
-    
-    // release print lock
-    stdSemV(&print);
+    // fire up the LCD, refreshed 16 times per second
+    stdLcdStart(0, stdSECOND/16);
     
     {
        /*
@@ -30,17 +30,17 @@ int main()
 
     while (1) {
         PORTC ^= (1 << LED_YELLOW);
-        printf_P( PSTR(" TESTa %d\r\n"), i++ );
+        uart_format_P( PSTR(" TESTa %d\r\n"), i++ );
 
         stdThreadSleep(stdSECOND);
 
         PORTC ^= (1 << LED_GREEN);
-        printf_P( PSTR(" TESTb %d\r\n"), i++ );
+        uart_format_P( PSTR(" TESTb %d\r\n"), i++ );
 
         stdThreadSleep(stdSECOND);
 
         PORTC ^= (1 << LED_RED);
-        printf_P( PSTR(" TESTc %d\r\n"), i++ );
+        uart_format_P( PSTR(" TESTc %d\r\n"), i++ );
 
         stdThreadSleep(stdSECOND);
     }
@@ -23,6 +23,8 @@
 
 /*-------------------------------- Includes ---------------------------------*/
 
+#include "stdThreads.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -52,17 +54,24 @@ extern "C" {
  *    for an appropriate duty cycle (to be determined for our IR LEDs).
  */
 
- #if       defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)
-               #define DC_PRESCALE   26
- #elif     defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz)
-               #define DC_PRESCALE   49
- #else
-               #error "Unsupported system frequency"
+ #define IR_CARRIER    37000UL
+
+ #define DC_PRESCALE   ((F_CPU/8 + IR_CARRIER/2) / IR_CARRIER - 1)
+
+ #if DC_PRESCALE < 1 || DC_PRESCALE > 255
+     #error "IR carrier not attainable at this system frequency"
  #endif
-        
 
 
 
+/*
+ * Pulse lengths as counted by TIMER1 with a clock prescale 
+ * of 256 while receiving. The values for the 8 MHz and 14 MHz
+ * boards were tuned by hand against real remotes, the values
+ * for other frequencies are derived from F_CPU:
+ */
+ #define IR_TICKS(us)  ((uInt16)(((F_CPU/256) * (us) + 500000UL) / 1000000UL))
+
  #if defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)
                #define MAX_ERROR     ((uInt16)7)
 
@@ -81,7 +90,13 @@ extern "C" {
                #define P_3_VAL     100   //  1.69 ms
                #define P_LLL_VAL  1200   // 21    ms
  #else
-               #error "Unsupported system frequency"
+               #define MAX_ERROR   IR_TICKS(  215)
+
+               #define P_L_VAL     IR_TICKS( 9000)
+               #define P_S_VAL     IR_TICKS( 4500)
+               #define P_1_VAL     IR_TICKS(  560)
+               #define P_3_VAL     IR_TICKS( 1690)
+               #define P_LLL_VAL   IR_TICKS(21000)
  #endif
 
 
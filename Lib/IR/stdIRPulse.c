@@ -155,7 +155,7 @@ void IRPulseStop( IRPulseOutput pin )
             typedef struct {
                 IRPulseOutput pin;
                 uInt32        value;
-                stdThread_t   thread;
+                Bool          active;
                 uInt16        decrement;
                  Int8         state;
                 Bool          atn;
@@ -163,36 +163,27 @@ void IRPulseStop( IRPulseOutput pin )
             
             
             static volatile IRStrobeInfoRec  IRStrobeInfo[2];
+            static struct stdSignalRec       IRStrobeDone[2];
             
                      
                 static void wakeStrober0()
-                { 
-                    stdThreadResume(IRStrobeInfo[0].thread); 
-                    IRStrobeInfo[0].thread = Null;
-                }
+                { stdSignalRaise(&IRStrobeDone[0]); }
 
                 static void wakeStrober1()
-                { 
-                    stdThreadResume(IRStrobeInfo[1].thread); 
-                    IRStrobeInfo[1].thread = Null;
-                }
+                { stdSignalRaise(&IRStrobeDone[1]); }
 
           /*
            * Scale the receive pulse values in
            * order to account for the different
-           * time unit used for sending:
+           * time unit used for sending; receive
+           * counts at F_CPU/256, while sending
+           * counts carrier periods of 8*DC_100 cycles:
            */
-           #if   defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)
-               #define S(p_val) (uInt16)(1.15*(uInt16)(p_val))
-           #elif defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz)
-               #define S(p_val) (uInt16)(0.64*(uInt16)(p_val))
-           #else
-               #error "unsupported THREADS_SYSTEM_CLOCK_FREQ"
-           #endif
+           #define S(p_val) (uInt16)( (uInt32)(p_val) * 256 / (8 * (DC_PRESCALE + 1)) )
 
 static void pulseTimerCOMPA( uInt8 timer )
 {
-    if (IRStrobeInfo[timer].thread) {
+    if (IRStrobeInfo[timer].active) {
         if (IRStrobeInfo[timer].state == -3) {
             IRLevelSwitch(IRStrobeInfo[timer].pin);
             IRStrobeInfo[timer].state++;
@@ -205,6 +196,8 @@ static void pulseTimerCOMPA( uInt8 timer )
                 IRStrobeInfo[timer].atn       = False;
             } else
             if (IRStrobeInfo[timer].state == 32) {
+                IRStrobeInfo[timer].active = False;
+
                 if (timer == 0) {
                     TIMSK0 &= ~(1<<OCIE0A);
                     stdRunISR(wakeStrober0);
@@ -245,13 +238,16 @@ void IRSendNECCode( IRPulseOutput pin, DutyCycle duty, uInt32 value, Bool longLe
 
     IRStrobeInfo[pindex].pin       = pin;
     IRStrobeInfo[pindex].value     = value;
-    IRStrobeInfo[pindex].thread    = stdCurrentThread;
+    IRStrobeInfo[pindex].active    = True;
     IRStrobeInfo[pindex].decrement = longLeader ? S(P_L_VAL) : S(P_S_VAL);
     IRStrobeInfo[pindex].state     = -3;
     IRStrobeInfo[pindex].atn       = False;
     
+    stdClockBoost();
+    stdSignalReset(&IRStrobeDone[pindex]);
     IRPulseStart(pin,duty,False,passiveHigh);
-    stdThreadSuspendSelf();
+    stdSignalWait(&IRStrobeDone[pindex], stdFOREVER);
     IRPulseStop(pin);
+    stdClockRelax();
 }
 
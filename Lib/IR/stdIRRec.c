@@ -123,7 +123,7 @@ static void shiftPulse( uInt16 pulseVal, void (*returnReceivedValue)(uInt32,Bool
 /* ------------------------------ IR Receiving ----------------------------- */
 
 
-        static volatile stdThread_t   IRRecWaiter;
+        static stdInstantiateSignal(  IRRecDone );
         static volatile uInt32        IRRecReceivedValue;
         static volatile uInt16        IRRecPreviousEventTime;
         static volatile Bool          IRLongLeader;
@@ -135,12 +135,9 @@ static void shiftPulse( uInt16 pulseVal, void (*returnReceivedValue)(uInt32,Bool
             stdISRLock()
             stdDisableInterrupts(&intenable);
             
-            if (IRRecWaiter) {
-                IRRecReceivedValue = value;
-                IRLongLeader       = longLeader;
-                stdThreadResume(IRRecWaiter); 
-                IRRecWaiter        = Null;
-            }
+            IRRecReceivedValue = value;
+            IRLongLeader       = longLeader;
+            stdSignalRaise(&IRRecDone); 
             
             stdRestoreInterrupts(intenable);
             stdISRUnLock()
@@ -200,12 +197,20 @@ void IRRecTimer1CAPT()
 
 uInt32 IRReceive( Bool *longLeader )
 {
+   /*
+    * Pulse timing assumes Timer1 counting 
+    * at F_CPU/256:
+    */
+    stdClockBoost();
+
+    stdSignalReset(&IRRecDone);
     IRRecStart();
     
-    IRRecWaiter = stdCurrentThread;
-    stdThreadSuspendSelf();
+    stdSignalWait(&IRRecDone, stdFOREVER);
     
     IRRecStop();
+
+    stdClockRelax();
     
    *longLeader = IRLongLeader;
     return IRRecReceivedValue;
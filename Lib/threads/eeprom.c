@@ -2,9 +2,16 @@
 #include "stdInterrupts.h" 
 
 
+/*
+ * Both functions restore the interrupt enabling 
+ * state of the caller, so that they can also be
+ * used from interrupt handlers:
+ */
 void EEPROM_write( uInt16 address, uInt8 value )
 {
-    stdXDisableInterrupts();
+    stdIFlags intenable;
+
+    stdDisableInterrupts(&intenable);
     
     while (EECR & (1<<EEPE)) {}
     
@@ -14,12 +21,14 @@ void EEPROM_write( uInt16 address, uInt8 value )
     EECR |= (1<<EEMPE);
     EECR |= (1<<EEPE);
     
-    stdXEnableInterrupts();
+    stdRestoreInterrupts(intenable);
 }
 
 uInt8 EEPROM_read( uInt16 address )
 {
-    stdXDisableInterrupts();
+    stdIFlags intenable;
+
+    stdDisableInterrupts(&intenable);
     
     while (EECR & (1<<EEPE)) {}
     
@@ -29,7 +38,7 @@ uInt8 EEPROM_read( uInt16 address )
     
     uInt8 result = EEDR;
     
-    stdXEnableInterrupts();
+    stdRestoreInterrupts(intenable);
     
     return result;
 }
@@ -11,6 +11,7 @@ void lcd_write_data(char c);
 void lcd_write_int16(int16_t in);
 void lcd_write_int16_centi(int16_t in);
 void lcd_write_string(const char *x);
+void lcd_format_P(const char *format, ...);
 void lcd_line_one();
 void lcd_line_two();
 void lcd_line_three();
@@ -16,25 +16,29 @@
 #include <stdThreads.h>
 
 #include "lcd.h"
+#include "stdFormat.h"
 
 
 /*
- * Redefinition of the functions in delay.h,
- * to prevent the CPU from being totally busy
- * with waiting during lcd updates.
+ * Waits used by the lcd functions below.
  *
- * For simplicity, we round every delay_us > 1
- * up to a delay_ms(1), which should not be a
- * problem for a low-intensity character display.
- * This simplification reduces the throughput, but 
- * the use of proper sleep functions also reduces
- * the processor load while printing.
- * 
- * For higher throughput I/O (such as printing
- * via a uart), better use an interrupt driven
- * output buffer.
+ * The execution time of character and cursor
+ * commands (some 40us) is busy waited with the
+ * cycle counted _delay_us from util/delay.h, which
+ * is far shorter than a kernel tick. Such a wait
+ * is at least as long as requested, also when the
+ * cpu clock has been scaled down from F_CPU.
+ *
+ * Only the milliseconds needed by clear, home
+ * and initialization are slept, so that other
+ * threads can run meanwhile.
+ *
+ * The R/W pin is not connected on the NerdKits
+ * board, so the busy flag cannot be read.
  */
 
+#include <util/delay.h>
+
 #define NOP __asm__ __volatile__ ("nop")
 
 static void delay_one_us() 
@@ -51,39 +55,32 @@ static void delay_one_us()
     NOP;
 }
 
-static void _delay_ms(uint16_t ms) 
+static void sleep_ms(uint16_t ms) 
 {
    /* 
     * divide by 1024 iso 1000, giving 
     * a slightly lower waiting time
     * (division by a non-power of two is very
-    * difficult for the AVR).
-    *
-    * However, the lcd does not seem to care
-    * the shorter waits:
+    * difficult for the AVR); the lcd does not 
+    * seem to care. Rounding up keeps short 
+    * waits from becoming zero at slow tick rates:
     */
-    stdThreadSleep( (ms * stdSECOND) / 1024 );
+    stdThreadSleep( ((uint32_t)ms * stdSECOND + 1023) / 1024 );
 }
 
 static void delay_ms(uint16_t ms) 
 {
     while (ms>500) {
-      _delay_ms(500);
+      sleep_ms(500);
       ms -= 500;
     }
     
-    _delay_ms(ms);
-}
-
-static void delay_us(uint16_t us) 
-{
-    _delay_ms(1);
+    sleep_ms(ms);
 }
 
+// us must be a compile time constant
+#define delay_us(us)   _delay_us(us)
 
-/* 
- * No further changes:
- */
 
 
 // lcd_set_type_data()
@@ -266,3 +263,18 @@ int lcd_putchar(char c, FILE *stream) {
   lcd_write_data(c);
   return 0;
 }
+
+static void lcd_sink(Pointer sink, const char *x, uint8_t length) {
+  while (length--) {
+    lcd_write_data(*x++);
+  }
+}
+
+// formatted output at the cursor, see stdFormat.h
+void lcd_format_P(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  stdFormatV_P(lcd_sink, Null, format, args);
+  va_end(args);
+}
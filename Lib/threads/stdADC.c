@@ -23,7 +23,53 @@
 
 /*-------------------------------- Functions --------------------------------*/
 
-    static stdThread_t adcWaiter;
+#define ADC_PRESCALE_BITS   ((1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0))
+
+   /*
+    * Prescale for the current cpu clock:
+    */
+    static uInt8 prescale;
+
+   /*
+    * ADC clock division by 2^prescale, 
+    * the ADC wants 50..200 kHz for full resolution:
+    */
+    static uInt8 adcPrescale( uInt32 frequency )
+    {
+        uInt8 prescale= 1;
+
+        while (prescale < 7 && (frequency >> prescale) > 200000UL) {
+            prescale++;
+        }
+
+        return prescale;
+    }
+
+   /*
+    * Called by threads, so ADCSRA is updated with interrupts
+    * disabled, against adcHandler clearing ADEN in between.
+    * ADIF is written as zero, so that a pending completion 
+    * is not cleared. A running conversion keeps its clock;
+    * adcRead applies the new prescale to the next one:
+    */
+    static void adcClockChanged( uInt32 frequency )
+    {
+        stdIFlags intenable;
+
+        stdDisableInterrupts(&intenable);
+        {
+            prescale= adcPrescale(frequency);
+
+            if (!(ADCSRA & (1<<ADSC))) {
+                ADCSRA = (ADCSRA & ~(ADC_PRESCALE_BITS|(1<<ADIF))) | prescale;
+            }
+        }
+        stdRestoreInterrupts(intenable);
+    }
+
+    static stdInstantiateClockHook( adcClock, adcClockChanged );
+
+    static stdInstantiateSignal( adcReady );
 
     static void adcHandler()
     {  
@@ -34,7 +80,7 @@
         */
         ADCSRA &= ~(1<<ADEN);
         
-        stdThreadResume(adcWaiter); 
+        stdSignalRaise(&adcReady); 
     }
 
     SIGNAL(ADC_vect)
@@ -42,22 +88,18 @@
 
 uInt16 adcRead()
 {
-   /*
-    * Flag current thread to be
-    * woken up at ADC interrupt:
-    */
-    adcWaiter = stdCurrentThread;
-
    /*
     * Fire a conversion:
     */
-    ADCSRA |= (1<<ADEN);
+    stdSignalReset(&adcReady);
+
+    ADCSRA = (ADCSRA & ~ADC_PRESCALE_BITS) | (1<<ADEN) | prescale;
     ADCSRA |= (1<<ADSC);
     
    /*
     * Wait until conversion is finished:
     */
-    stdThreadSuspendSelf();
+    stdSignalWait(&adcReady, stdFOREVER);
     
    /*
     * Read the ADC conversion result
@@ -84,11 +126,14 @@ void adcSetup( uInt8 mux )
     ADMUX = mux;
     
    /*
-    * Set ADC to be enabled, with a clock prescale of 1/128
-    * so that the ADC clock runs at 115.2 kHz.
-    * TODO: this should be depending on THREADS_SYSTEM_CLOCK_FREQ
+    * Set ADC to be enabled, with the smallest clock prescale
+    * that keeps the ADC clock at or below 200 kHz:
     */
-    ADCSRA = (1<<ADIE) | (1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0);
+    prescale= adcPrescale( stdClockFrequency() );
+
+    ADCSRA = (1<<ADIE) | prescale;
+
+    stdClockHookAdd(&adcClock);
     
    /*
     * Do a conversion to warm up the ADC:
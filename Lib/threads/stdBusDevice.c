@@ -0,0 +1,59 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements the serial bus device helpers.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include "stdThreads.h"
+#include "stdBusDevice.h"
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Make the chip select pin of a device an output,
+ *                   and deselect the device.
+ * Parameters      : device     (I) Device to set up.
+ */
+void stdBusAttach( stdBusDevice_t device )
+{
+    stdBusDeselect(device);
+
+   *device->csDdr |= device->csMask;
+}
+
+
+/*
+ * Function        : Check whether the clock settings that a driver derived
+ *                   for a device are outdated, because they were not derived
+ *                   yet or the cpu clock has changed since. The device is
+ *                   marked up to date, so the caller must rederive them.
+ * Parameters      : device     (I) Device to check.
+ * Function Result : True iff. the settings must be rederived.
+ */
+Bool stdBusClockChanged( stdBusDevice_t device )
+{
+    uInt32 clock= stdClockFrequency();
+
+    if (device->clock == clock) {
+        return False;
+    }
+
+    device->clock= clock;
+
+    return True;
+}
@@ -0,0 +1,89 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides the device description shared by the serial
+ *         bus drivers stdSpi and stdUSpi: a chip select pin, which is
+ *         driven low while the device is addressed, a bus mode, and a
+ *         maximal clock frequency, from which the drivers derive their
+ *         clock divider settings for the current cpu clock.
+ */
+
+#ifndef stdBusDevice_INCLUDED
+#define stdBusDevice_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include <avr/io.h>
+#include "stdTypes.h"
+
+/*---------------------------------- Types ----------------------------------*/
+
+typedef struct stdBusDeviceRec *stdBusDevice_t;
+
+struct stdBusDeviceRec {
+    volatile uInt8  *csPort;
+    volatile uInt8  *csDdr;
+    uInt8            csMask;
+    uInt8            mode;
+    uInt32           frequency;
+
+   /* private: */
+    uInt32           clock;         // cpu clock of the derived settings
+};
+
+/*
+ * Function        : Initializer of a device description.
+ * Parameters      : port       (I) Port letter of the chip select pin,
+ *                                  for instance C.
+ *                   pin        (I) Chip select pin number, for instance PC5.
+ *                   mode       (I) Driver specific bus mode.
+ *                   frequency  (I) Maximal bus clock frequency in Hz.
+ */
+#define stdBUS_DEVICE(port,pin,mode,frequency) \
+           { &PORT##port, &DDR##port, 1<<(pin), mode, frequency, 0 }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Make the chip select pin of a device an output,
+ *                   and deselect the device.
+ * Parameters      : device     (I) Device to set up.
+ */
+void stdBusAttach( stdBusDevice_t device );
+
+
+/*
+ * Function        : Select/deselect a device.
+ * Parameters      : device     (I) Device to select or deselect.
+ */
+void stdBusSelect  ( stdBusDevice_t device );
+void stdBusDeselect( stdBusDevice_t device );
+
+#define stdBusSelect(device)    { *(device)->csPort &= ~(device)->csMask; }
+#define stdBusDeselect(device)  { *(device)->csPort |=  (device)->csMask; }
+
+
+/*
+ * Function        : Check whether the clock settings that a driver derived
+ *                   for a device are outdated, because they were not derived
+ *                   yet or the cpu clock has changed since. The device is
+ *                   marked up to date, so the caller must rederive them.
+ * Parameters      : device     (I) Device to check.
+ * Function Result : True iff. the settings must be rederived.
+ */
+Bool stdBusClockChanged( stdBusDevice_t device );
+
+#endif
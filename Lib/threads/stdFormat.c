@@ -0,0 +1,257 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements small formatted output.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include <string.h>
+#include "stdFormat.h"
+
+/*------------------------------- Module State ------------------------------*/
+
+/*
+ * Number of characters collected
+ * before calling the sink:
+ */
+#define CHUNK_SIZE     16
+
+typedef struct {
+    stdFormatSink  put;
+    Pointer        sink;
+    uInt16         count;
+    uInt8          fill;
+    char           chunk[CHUNK_SIZE];
+} Output;
+
+/*--------------------------------- Output ----------------------------------*/
+
+    static void flush( Output *out )
+    {
+        if (out->fill) {
+            out->put(out->sink, out->chunk, out->fill);
+            out->fill= 0;
+        }
+    }
+
+    static void emit( Output *out, char c )
+    {
+        out->chunk[out->fill++]= c;
+        out->count++;
+
+        if (out->fill == CHUNK_SIZE) {
+            flush(out);
+        }
+    }
+
+    static void pad( Output *out, char c, Int8 n )
+    {
+        while (n-- > 0) {
+            emit(out, c);
+        }
+    }
+
+   /*
+    * Emit a string from RAM or program memory,
+    * padded with spaces to width:
+    */
+    static void emitString( Output *out, const char *s, Bool progmem, Int8 width, Bool left )
+    {
+        Int8 length= progmem ? strlen_P(s) : strlen(s);
+
+        if (!left) { pad(out, ' ', width - length); }
+
+        while (True) {
+            char c= progmem ? pgm_read_byte(s) : *s;
+
+            if (!c) { break; }
+
+            emit(out, c);
+            s++;
+        }
+
+        if (left)  { pad(out, ' ', width - length); }
+    }
+
+   /*
+    * Emit a number in base 10 or 16,
+    * padded to width:
+    */
+    static void emitNumber( Output *out, uInt32 value, Bool negative, uInt8 base, Bool upper,
+                            Int8 width, Bool left, Bool zero )
+    {
+        char  digits[10];
+        Int8  length= 0;
+
+        do {
+            uInt8 digit= value % base;
+
+            digits[length++]= digit < 10 ? '0' + digit : (upper ? 'A' : 'a') + digit - 10;
+            value /= base;
+        } while (value);
+
+        width -= length + negative;
+
+        if (zero && !left) {
+            if (negative) { emit(out, '-'); }
+            pad(out, '0', width);
+        } else {
+            if (!left)    { pad(out, ' ', width); }
+            if (negative) { emit(out, '-'); }
+        }
+
+        while (length) {
+            emit(out, digits[--length]);
+        }
+
+        if (left) { pad(out, ' ', width); }
+    }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Format to a sink.
+ * Parameters      : put        (I) Output function.
+ *                   sink       (I) First argument of put.
+ *                   format     (I) Format string, in program memory.
+ *                   args       (I) Values for the conversions in format.
+ * Function Result : Number of characters produced.
+ */
+uInt16 stdFormatV_P( stdFormatSink put, Pointer sink, PGM_P format, va_list args )
+{
+    Output out;
+    char   c;
+
+    out.put   = put;
+    out.sink  = sink;
+    out.count = 0;
+    out.fill  = 0;
+
+    while ( (c= pgm_read_byte(format++)) ) {
+        Bool left= False, zero= False, isLong= False;
+        Int8 width= 0;
+
+        if (c != '%') {
+            emit(&out, c);
+            continue;
+        }
+
+        c= pgm_read_byte(format++);
+
+        if (c == '-') { left= True; c= pgm_read_byte(format++); }
+        if (c == '0') { zero= True; c= pgm_read_byte(format++); }
+
+        while (c >= '0' && c <= '9') {
+            width= 10*width + c - '0';
+            c= pgm_read_byte(format++);
+        }
+
+        if (c == 'l') { isLong= True; c= pgm_read_byte(format++); }
+
+        switch (c) {
+        case 'd' : {
+                       Int32 value= isLong ? va_arg(args, Int32) : va_arg(args, int);
+
+                       if (value < 0) {
+                           emitNumber(&out, -(uInt32)value, True,  10, False, width, left, zero);
+                       } else {
+                           emitNumber(&out,  value, False, 10, False, width, left, zero);
+                       }
+                       break;
+                   }
+
+        case 'u' :
+        case 'x' :
+        case 'X' : {
+                       uInt32 value= isLong ? va_arg(args, uInt32) : va_arg(args, unsigned);
+
+                       emitNumber(&out, value, False, c == 'u' ? 10 : 16, c == 'X', width, left, zero);
+                       break;
+                   }
+
+        case 'c' : emit(&out, (char)va_arg(args, int));                                  break;
+        case 's' : emitString(&out, va_arg(args, const char*), False, width, left);      break;
+        case 'S' : emitString(&out, va_arg(args, const char*), True,  width, left);      break;
+        case  0  : format--;                                                             break;
+        default  : emit(&out, c);                                                        break;
+        }
+    }
+
+    flush(&out);
+
+    return out.count;
+}
+
+uInt16 stdFormat_P( stdFormatSink put, Pointer sink, PGM_P format, ... )
+{
+    va_list args;
+    uInt16  result;
+
+    va_start(args, format);
+    result= stdFormatV_P(put, sink, format, args);
+    va_end(args);
+
+    return result;
+}
+
+
+   /*
+    * Sink for stdFormatString_P:
+    */
+    typedef struct {
+        char    *next;
+        uInt16   left;
+    } Buffer;
+
+    static void putBuffer( Buffer *buffer, const char *chars, uInt8 length )
+    {
+        while (length-- && buffer->left) {
+           *buffer->next++ = *chars++;
+            buffer->left--;
+        }
+    }
+
+
+/*
+ * Function        : Format into a character buffer, truncating the output
+ *                   when it does not fit, and terminating it with a zero.
+ * Parameters      : buffer     (O) Buffer to write to.
+ *                   size       (I) Size of buffer, including terminator.
+ *                   format     (I) Format string, in program memory.
+ *                   ...        (I) Values for the conversions in format.
+ * Function Result : Number of characters stored, excluding the terminator.
+ */
+uInt16 stdFormatString_P( char *buffer, uInt16 size, PGM_P format, ... )
+{
+    va_list args;
+    Buffer  out;
+
+    if (!size) {
+        return 0;
+    }
+
+    out.next= buffer;
+    out.left= size - 1;
+
+    va_start(args, format);
+    stdFormatV_P((stdFormatSink)putBuffer, &out, format, args);
+    va_end(args);
+
+   *out.next= 0;
+
+    return out.next - buffer;
+}
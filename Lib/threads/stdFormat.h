@@ -0,0 +1,71 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides small formatted output, as a replacement
+ *         for printf_P that does not need avr-libc stdio. Format strings
+ *         are in program memory, and output is passed in chunks to a
+ *         sink function, such as the uart transmit buffer (uart_format_P),
+ *         the lcd (lcd_format_P) or a character buffer.
+ *
+ *         Conversions, with optional '-' or '0' flag, width, and 'l'
+ *         for long arguments:
+ *
+ *             %d  %u  %x  %X  %c  %s  %S (string in program memory)  %%
+ */
+
+#ifndef stdFormat_INCLUDED
+#define stdFormat_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include <stdarg.h>
+#include <avr/pgmspace.h>
+#include "stdTypes.h"
+
+/*---------------------------------- Types ----------------------------------*/
+
+/*
+ * Output function, called with successive
+ * chunks of formatted characters:
+ */
+typedef void (*stdFormatSink)( Pointer sink, const char *chars, uInt8 length );
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Format to a sink.
+ * Parameters      : put        (I) Output function.
+ *                   sink       (I) First argument of put.
+ *                   format     (I) Format string, in program memory.
+ *                   ...        (I) Values for the conversions in format.
+ * Function Result : Number of characters produced.
+ */
+uInt16 stdFormat_P ( stdFormatSink put, Pointer sink, PGM_P format, ... );
+uInt16 stdFormatV_P( stdFormatSink put, Pointer sink, PGM_P format, va_list args );
+
+
+/*
+ * Function        : Format into a character buffer, truncating the output
+ *                   when it does not fit, and terminating it with a zero.
+ * Parameters      : buffer     (O) Buffer to write to.
+ *                   size       (I) Size of buffer, including terminator.
+ *                   format     (I) Format string, in program memory.
+ *                   ...        (I) Values for the conversions in format.
+ * Function Result : Number of characters stored, excluding the terminator.
+ */
+uInt16 stdFormatString_P( char *buffer, uInt16 size, PGM_P format, ... );
+
+#endif
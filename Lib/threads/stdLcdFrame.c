@@ -0,0 +1,220 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements the lcd frame buffer and its refresher.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "stdThreads.h"
+#include "stdFormat.h"
+#include "stdLcdFrame.h"
+#include "lcd.h"
+
+/*------------------------------- Module State ------------------------------*/
+
+/*
+ * Cells written by threads, and cells as last
+ * sent to the lcd. Zero cells are blank, just as
+ * the lcd after initialization, so that both start
+ * out equal without explicit initialization:
+ */
+static volatile char   frame[stdLCD_ROWS][stdLCD_COLUMNS];
+static          char   shown[stdLCD_ROWS][stdLCD_COLUMNS];
+
+/*
+ * A row is marked dirty after it has been written,
+ * and unmarked by the refresher before comparing it,
+ * so that writes during a refresh are picked up by
+ * the next one. Byte stores need no locking:
+ */
+static volatile Bool   rowDirty[stdLCD_ROWS];
+
+static uInt16          refreshPeriod;
+
+static void refreshLoop();
+
+stdInstantiateThread( stdLcdRefresher, stdLCD_STACK_SIZE, refreshLoop, 0, 0, Null );
+
+/*--------------------------------- Refresh ---------------------------------*/
+
+   /*
+    * Send the changed cells of a row; the lcd cursor
+    * advances by itself after each character, so it
+    * only needs to be moved over unchanged cells. At
+    * the end of a row, the lcd continues on another row,
+    * which is never the next one in frame order:
+    */
+    static void refreshRow( uInt8 row, uInt8 *cursorRow, uInt8 *cursorCol )
+    {
+        uInt8 col;
+
+        for (col= 0; col < stdLCD_COLUMNS; col++) {
+            char c= frame[row][col];
+
+            if (c != shown[row][col]) {
+                if (*cursorRow != row || *cursorCol != col) {
+                    lcd_goto_position(row, col);
+                }
+
+                lcd_write_data(c ? c : ' ');
+
+                shown[row][col]= c;
+               *cursorRow      = row;
+               *cursorCol      = col + 1;
+            }
+        }
+    }
+
+static void refreshLoop()
+{
+    uInt8 cursorRow= 0, cursorCol= 0;
+
+    lcd_init();
+
+    while (True) {
+        uInt8 row;
+
+        for (row= 0; row < stdLCD_ROWS; row++) {
+            if (rowDirty[row]) {
+                rowDirty[row]= False;
+                refreshRow(row, &cursorRow, &cursorCol);
+            }
+        }
+
+        stdThreadSleep(refreshPeriod);
+    }
+}
+
+/*--------------------------------- Writing ---------------------------------*/
+
+   /*
+    * Current write position, for the format sink:
+    */
+    typedef struct {
+        uInt8  row;
+        uInt8  col;
+    } Position;
+
+    static void putPosition( Position *position, const char *chars, uInt8 length )
+    {
+        while (length-- && position->col < stdLCD_COLUMNS) {
+            frame[position->row][position->col++]= *chars++;
+        }
+    }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Start the refresher thread, which first
+ *                   initializes the lcd via lcd_init.
+ * Parameters      : prio       (I) Priority of the refresher thread;
+ *                                  normally low.
+ *                   period     (I) Kernel ticks between refreshes.
+ */
+void stdLcdStart( uInt8 prio, uInt16 period )
+{
+    refreshPeriod= period;
+
+    stdLcdRefresher.priority= prio;
+    stdThreadResume(&stdLcdRefresher);
+}
+
+
+/*
+ * Function        : Fill the frame buffer with spaces.
+ */
+void stdLcdClear()
+{
+    uInt8 row;
+
+    for (row= 0; row < stdLCD_ROWS; row++) {
+        memset((char*)frame[row], 0, stdLCD_COLUMNS);
+        rowDirty[row]= True;
+    }
+}
+
+
+/*
+ * Function        : Write a character into the frame buffer.
+ * Parameters      : row        (I) Row, 0 .. stdLCD_ROWS-1.
+ *                   col        (I) Column, 0 .. stdLCD_COLUMNS-1.
+ *                   c          (I) Character to write.
+ */
+void stdLcdPut( uInt8 row, uInt8 col, char c )
+{
+    if (row < stdLCD_ROWS && col < stdLCD_COLUMNS) {
+        frame[row][col]= c;
+        rowDirty[row]  = True;
+    }
+}
+
+
+/*
+ * Function        : Write a string into the frame buffer.
+ * Parameters      : row        (I) Row, 0 .. stdLCD_ROWS-1.
+ *                   col        (I) Column of the first character.
+ *                   s          (I) String, in RAM or in program memory (_P).
+ */
+void stdLcdWrite( uInt8 row, uInt8 col, const char *s )
+{
+    if (row < stdLCD_ROWS) {
+        while (*s && col < stdLCD_COLUMNS) {
+            frame[row][col++]= *s++;
+        }
+        rowDirty[row]= True;
+    }
+}
+
+void stdLcdWrite_P( uInt8 row, uInt8 col, PGM_P s )
+{
+    if (row < stdLCD_ROWS) {
+        char c;
+
+        while ( (c= pgm_read_byte(s++)) && col < stdLCD_COLUMNS ) {
+            frame[row][col++]= c;
+        }
+        rowDirty[row]= True;
+    }
+}
+
+
+/*
+ * Function        : Format into the frame buffer, see stdFormat.h.
+ * Parameters      : row        (I) Row, 0 .. stdLCD_ROWS-1.
+ *                   col        (I) Column of the first character.
+ *                   format     (I) Format string, in program memory.
+ *                   ...        (I) Values for the conversions in format.
+ */
+void stdLcdFormat_P( uInt8 row, uInt8 col, PGM_P format, ... )
+{
+    va_list  args;
+    Position position;
+
+    if (row < stdLCD_ROWS) {
+        position.row= row;
+        position.col= col;
+
+        va_start(args, format);
+        stdFormatV_P((stdFormatSink)putPosition, &position, format, args);
+        va_end(args);
+
+        rowDirty[row]= True;
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides a frame buffer for the 4x20 character lcd.
+ *         Threads write text into the frame buffer, which never blocks
+ *         and needs no lock, and a refresher thread periodically sends
+ *         the cells that differ from what the lcd shows, moving the lcd
+ *         cursor only where consecutive changed cells are not adjacent.
+ *
+ *         Text is clipped at the end of its row. When several threads
+ *         write the same cells, the last write wins.
+ */
+
+#ifndef stdLcdFrame_INCLUDED
+#define stdLcdFrame_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include <avr/pgmspace.h>
+#include "stdTypes.h"
+
+/*-------------------------------- Functions --------------------------------*/
+
+#define stdLCD_ROWS        4
+#define stdLCD_COLUMNS    20
+
+/*
+ * Stack size of the refresher thread:
+ */
+#ifndef stdLCD_STACK_SIZE
+#define stdLCD_STACK_SIZE  80
+#endif
+
+/*
+ * Function        : Start the refresher thread, which first
+ *                   initializes the lcd via lcd_init.
+ * Parameters      : prio       (I) Priority of the refresher thread;
+ *                                  normally low.
+ *                   period     (I) Kernel ticks between refreshes.
+ */
+void stdLcdStart( uInt8 prio, uInt16 period );
+
+
+/*
+ * Function        : Fill the frame buffer with spaces.
+ */
+void stdLcdClear();
+
+
+/*
+ * Function        : Write a character into the frame buffer.
+ * Parameters      : row        (I) Row, 0 .. stdLCD_ROWS-1.
+ *                   col        (I) Column, 0 .. stdLCD_COLUMNS-1.
+ *                   c          (I) Character to write.
+ */
+void stdLcdPut( uInt8 row, uInt8 col, char c );
+
+
+/*
+ * Function        : Write a string into the frame buffer.
+ * Parameters      : row        (I) Row, 0 .. stdLCD_ROWS-1.
+ *                   col        (I) Column of the first character.
+ *                   s          (I) String, in RAM or in program memory (_P).
+ */
+void stdLcdWrite  ( uInt8 row, uInt8 col, const char *s );
+void stdLcdWrite_P( uInt8 row, uInt8 col, PGM_P s );
+
+
+/*
+ * Function        : Format into the frame buffer, see stdFormat.h.
+ * Parameters      : row        (I) Row, 0 .. stdLCD_ROWS-1.
+ *                   col        (I) Column of the first character.
+ *                   format     (I) Format string, in program memory.
+ *                   ...        (I) Values for the conversions in format.
+ */
+void stdLcdFormat_P( uInt8 row, uInt8 col, PGM_P format, ... );
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements the kernel introspection shell.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "stdThreads.h"
+#include "stdShell.h"
+#include "uart.h"
+
+#if defined(THREADS_REGISTRY_ON)
+
+/*------------------------------- Module State ------------------------------*/
+
+#define LINE_SIZE     16
+#define TIMED_MAX      8
+
+static void shellLoop();
+
+stdInstantiateThread( stdShell, stdSHELL_STACK_SIZE, shellLoop, 0, 0, Null );
+
+/*---------------------------------- Names ----------------------------------*/
+
+   /*
+    * Print the name of the registered thread, task runner
+    * or pool slot that is thread, or else its address:
+    */
+    static void printThreadName( stdThread_t thread )
+    {
+        stdRegistry_t entry;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            if (entry->kind == stdOBJ_THREAD_POOL) {
+                stdThreadPool_t pool= entry->object;
+
+                if (thread >= pool->threads && thread < pool->threads + pool->size) {
+                    uart_format_P( PSTR("%S[%d]"), entry->name, (int)(thread - pool->threads) );
+                    return;
+                }
+            } else
+            if ( (entry->kind == stdOBJ_THREAD || entry->kind == stdOBJ_TASK_RUNNER)
+              && entry->object == thread
+               ) {
+                uart_format_P( PSTR("%S"), entry->name );
+                return;
+            }
+        }
+
+        uart_format_P( PSTR("0x%04x"), (uInt16)thread );
+    }
+
+   /*
+    * Print the name of the object owning
+    * the wait queue in which a thread is blocked:
+    */
+    static void printWaitQName( ThreadPrioQ_t *waitQ )
+    {
+        stdRegistry_t entry;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            ThreadPrioQ_t *queue= Null, *other= Null;
+
+            switch (entry->kind) {
+            case stdOBJ_SEMAPHORE : queue= &((stdSem_t   )entry->object)->waitQ;     break;
+            case stdOBJ_CONDITION : queue= &((stdCond_t  )entry->object)->waitQ;     break;
+            case stdOBJ_SIGNAL    : queue= &((stdSignal_t)entry->object)->waitQ;     break;
+            case stdOBJ_EVENTS    : queue= &((stdEvents_t)entry->object)->waitQ;     break;
+            case stdOBJ_THREAD    :
+            case stdOBJ_TASK_RUNNER:queue= &((stdThread_t)entry->object)->joinQ;     break;
+            case stdOBJ_QUEUE     : queue= &((stdQueue_t )entry->object)->put.waitQ;
+                                    other= &((stdQueue_t )entry->object)->get.waitQ; break;
+            }
+
+            if (waitQ == queue) {
+                uart_format_P( PSTR("%S"), entry->name );
+                return;
+            }
+            if (waitQ == other) {
+                uart_format_P( PSTR("%S.get"), entry->name );
+                return;
+            }
+        }
+
+        uart_format_P( PSTR("0x%04x"), (uInt16)waitQ );
+    }
+
+   /*
+    * Count the registered threads that
+    * are blocked in a wait queue:
+    */
+    static uInt8 waiters( ThreadPrioQ_t *waitQ )
+    {
+        stdRegistry_t entry;
+        uInt8         result= 0;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            if (entry->kind == stdOBJ_THREAD || entry->kind == stdOBJ_TASK_RUNNER) {
+                if ( ((stdThread_t)entry->object)->waitQ == waitQ ) { result++; }
+            } else
+            if (entry->kind == stdOBJ_THREAD_POOL) {
+                stdThreadPool_t pool= entry->object;
+                uInt8           i;
+
+                for (i= 0; i < pool->size; i++) {
+                    if (pool->threads[i].waitQ == waitQ) { result++; }
+                }
+            }
+        }
+
+        return result;
+    }
+
+/*--------------------------------- Commands --------------------------------*/
+
+    static void showThread( stdThread_t thread, Byte *stack, uInt16 ssize )
+    {
+        static const char states[][10] PROGMEM =
+            { "running", "runnable", "waiting", "sleeping", "suspended", "exited" };
+
+        struct stdThreadInfoRec info;
+
+        stdThreadInfo(thread, &info);
+
+        printThreadName(thread);
+        uart_format_P( PSTR("\t%3d %-9S"), thread->priority, states[info.state] );
+
+        if (ssize > 1) {
+            uart_format_P( PSTR(" stack %u/%u"), ssize - stdStackUnused(stack, ssize), ssize );
+        }
+        if (info.waitQ) {
+            uart_format_P( PSTR(" on ") );
+            printWaitQName(info.waitQ);
+        }
+        if (info.ticks) {
+            uart_format_P( PSTR(" %u ticks left"), info.ticks );
+        }
+
+        uart_format_P( PSTR("\r\n") );
+    }
+
+    static void showThreads()
+    {
+        stdRegistry_t entry;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            if (entry->kind == stdOBJ_THREAD || entry->kind == stdOBJ_TASK_RUNNER) {
+                showThread(entry->object, entry->stack, entry->ssize);
+            } else
+            if (entry->kind == stdOBJ_THREAD_POOL) {
+                stdThreadPool_t pool= entry->object;
+                uInt8           i;
+
+                for (i= 0; i < pool->size; i++) {
+                    showThread(&pool->threads[i], pool->stacks + i*pool->ssize, pool->ssize);
+                }
+            }
+        }
+    }
+
+    static void showTasks()
+    {
+        stdRegistry_t entry;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            if (entry->kind == stdOBJ_TASK) {
+                stdTask_t task= entry->object;
+
+                uart_format_P( PSTR("%S\t%3d on "), entry->name, task->priority );
+                printThreadName(&task->runner->thread);
+
+                if (task->period) {
+                    uart_format_P( PSTR(" every %u ticks"), task->period );
+                }
+
+                uart_format_P( PSTR("\r\n") );
+            }
+        }
+    }
+
+    static void showSync()
+    {
+        stdRegistry_t entry;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            Pointer object= entry->object;
+
+            switch (entry->kind) {
+            case stdOBJ_SEMAPHORE :
+                uart_format_P( PSTR("%S\tsemaphore count %d, %d waiting\r\n"), entry->name,
+                          ((stdSem_t)object)->count, waiters(&((stdSem_t)object)->waitQ) );
+                break;
+
+            case stdOBJ_CONDITION :
+                uart_format_P( PSTR("%S\tcondition %d waiting\r\n"), entry->name,
+                          waiters(&((stdCond_t)object)->waitQ) );
+                break;
+
+            case stdOBJ_SIGNAL :
+                uart_format_P( PSTR("%S\tsignal %S, %d waiting\r\n"), entry->name,
+                          ((stdSignal_t)object)->raised ? PSTR("raised") : PSTR("reset"),
+                          waiters(&((stdSignal_t)object)->waitQ) );
+                break;
+
+            case stdOBJ_EVENTS :
+                uart_format_P( PSTR("%S\tevents 0x%02x, %d waiting\r\n"), entry->name,
+                          ((stdEvents_t)object)->flags, waiters(&((stdEvents_t)object)->waitQ) );
+                break;
+            }
+        }
+    }
+
+    static void showQueues()
+    {
+        stdRegistry_t entry;
+
+        for (entry= stdRegistryList(); entry; entry= entry->next) {
+            if (entry->kind == stdOBJ_QUEUE) {
+                stdQueue_t queue= entry->object;
+
+                uart_format_P( PSTR("%S\t%d/%d, %d putting, %d getting\r\n"), entry->name,
+                          queue->get.count, queue->mask + 1,
+                          waiters(&queue->put.waitQ), waiters(&queue->get.waitQ) );
+            }
+        }
+    }
+
+    static void showTimers()
+    {
+        stdThread_t threads[TIMED_MAX];
+        uInt16      ticks  [TIMED_MAX];
+        uInt8       count, i;
+
+        count= stdTimerQueueSnapshot(threads, ticks, TIMED_MAX);
+
+        for (i= 0; i < count; i++) {
+            uart_format_P( PSTR("%5u "), ticks[i] );
+            printThreadName(threads[i]);
+            uart_format_P( PSTR("\r\n") );
+        }
+    }
+
+/*-------------------------------- Shell Loop -------------------------------*/
+
+   /*
+    * Read a line from stdin with echo;
+    * returns its length:
+    */
+    static uInt8 readLine( char *line )
+    {
+        uInt8 length= 0;
+
+        while (True) {
+            char c= uart_read();
+
+            if (c == '\r' || c == '\n') {
+                uart_format_P( PSTR("\r\n") );
+                line[length]= 0;
+                return length;
+            } else
+            if ( (c == '\b' || c == 0x7f) && length) {
+                uart_format_P( PSTR("\b \b") );
+                length--;
+            } else
+            if (c >= ' ' && length < LINE_SIZE-1) {
+                uart_write(c);
+                line[length++]= c;
+            }
+        }
+    }
+
+    static Bool is( const char *line, uInt8 length, PGM_P command )
+    {
+        return length && strncmp_P(line, command, length) == 0;
+    }
+
+static void shellLoop()
+{
+    char  line[LINE_SIZE];
+    uInt8 length;
+
+    while (True) {
+        uart_format_P( PSTR("> ") );
+
+        length= readLine(line);
+
+        if (is(line, length, PSTR("threads"))) { showThreads(); } else
+        if (is(line, length, PSTR("tasks"  ))) { showTasks();   } else
+        if (is(line, length, PSTR("sync"   ))) { showSync();    } else
+        if (is(line, length, PSTR("queues" ))) { showQueues();  } else
+        if (is(line, length, PSTR("timers" ))) { showTimers();  } else
+        if (length) {
+            uart_format_P( PSTR("threads tasks sync queues timers\r\n") );
+        }
+    }
+}
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Start the shell thread, reading commands from
+ *                   the uart, which must have been set up by uart_init.
+ * Parameters      : prio       (I) Priority of the shell thread; normally
+ *                                  lower than all other threads.
+ */
+void stdShellStart( uInt8 prio )
+{
+    stdShell.priority= prio;
+    stdThreadResume(&stdShell);
+}
+
+#endif
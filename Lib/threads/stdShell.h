@@ -0,0 +1,61 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides a command shell on the uart for inspecting
+ *         the kernel objects of a running program: threads with their
+ *         state, stack high-water marks, synchronization objects,
+ *         queues and the timer queue. It needs the object registry,
+ *         that is, compilation with THREADS_REGISTRY=ON.
+ *
+ *         Commands, which may be abbreviated:
+ *
+ *             threads     threads, task runners and pool slots
+ *             tasks       run-to-completion tasks
+ *             sync        semaphores, mutexes, conditions, signals, events
+ *             queues      bounded queues
+ *             timers      threads in the timer queue
+ *             help
+ */
+
+#ifndef stdShell_INCLUDED
+#define stdShell_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include "stdTypes.h"
+
+/*-------------------------------- Functions --------------------------------*/
+
+#if defined(THREADS_REGISTRY_ON)
+
+/*
+ * Stack size of the shell thread:
+ */
+#ifndef stdSHELL_STACK_SIZE
+#define stdSHELL_STACK_SIZE  160
+#endif
+
+/*
+ * Function        : Start the shell thread, reading commands from
+ *                   the uart, which must have been set up by uart_init.
+ * Parameters      : prio       (I) Priority of the shell thread; normally
+ *                                  lower than all other threads.
+ */
+void stdShellStart( uInt8 prio );
+
+#endif
+
+#endif
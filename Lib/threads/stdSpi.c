@@ -0,0 +1,220 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements queued SPI master transfers.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include "stdThreads.h"
+#include "stdSpi.h"
+
+/*------------------------------- Module State ------------------------------*/
+
+#define SS_PIN     (1<<PB2)
+#define MOSI_PIN   (1<<PB3)
+#define SCK_PIN    (1<<PB5)
+
+/*
+ * Submitted transactions; the head of
+ * the queue is the one being transferred:
+ */
+static stdSpiTransaction_t  queueHead;
+static stdSpiTransaction_t  queueTail;
+
+/*
+ * Progress of the head transaction:
+ */
+static const uInt8         *txNext;
+static uInt8               *rxNext;
+static uInt16               left;
+
+/*
+ * Signal of the transaction that
+ * has just completed:
+ */
+static stdSignal_t          completed;
+
+/*---------------------------- Transfer Control -----------------------------*/
+
+   /*
+    * SPCR and SPSR values for the highest SCK frequency
+    * that does not exceed that of device, which is the cpu
+    * clock divided by 2^(n+1), n= 0..6:
+    */
+    static void deviceSetup( stdSpiDevice_t device )
+    {
+        if (stdBusClockChanged(&device->bus)) {
+            uInt8 n= 0;
+
+            while (n < 6 && (device->bus.clock >> (n+1)) > device->bus.frequency) {
+                n++;
+            }
+
+            device->spcr = (1<<SPE) | (1<<MSTR) | (1<<SPIE) | device->bus.mode;
+
+            if (n == 6) {
+                device->spcr |= (1<<SPR1) | (1<<SPR0);
+                device->spsr  = 0;
+            } else {
+                device->spcr |= n >> 1;
+                device->spsr  = (n & 1) ? 0 : (1<<SPI2X);
+            }
+        }
+    }
+
+   /*
+    * Select the device of the head transaction,
+    * and send its first byte:
+    */
+    static void start()
+    {
+        stdSpiTransaction_t transaction= queueHead;
+        stdSpiDevice_t      device     = transaction->device;
+
+        SPCR = device->spcr;
+        SPSR = device->spsr;
+
+        stdBusSelect(&device->bus);
+
+        txNext = transaction->tx;
+        rxNext = transaction->rx;
+        left   = transaction->size;
+
+        SPDR = txNext ? *txNext++ : 0xff;
+    }
+
+    static void completionHandler()
+    {
+        stdSignalRaise(completed);
+    }
+
+   /*
+    * A byte has been exchanged; send the next one,
+    * or else complete the head transaction and
+    * start the next one in the queue:
+    */
+    SIGNAL(SPI_STC_vect)
+    {
+        stdSpiTransaction_t transaction;
+        uInt8               x= SPDR;
+
+        if (--left) {
+            SPDR = txNext ? *txNext++ : 0xff;
+
+            if (rxNext) { *rxNext++ = x; }
+            return;
+        }
+
+        if (rxNext) { *rxNext = x; }
+
+        transaction= queueHead;
+
+        stdBusDeselect(&transaction->device->bus);
+
+        queueHead= transaction->next;
+
+        if (queueHead) {
+            start();
+        } else {
+            queueTail= Null;
+        }
+
+        if (transaction->done) {
+            completed= transaction->done;
+            stdRunISR(completionHandler);
+        }
+    }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Power up the SPI as master.
+ */
+void stdSpiInit()
+{
+    PRR  &= ~(1<<PRSPI);
+    DDRB |= SS_PIN | MOSI_PIN | SCK_PIN;
+
+    queueHead= Null;
+    queueTail= Null;
+}
+
+
+/*
+ * Function        : Queue a transaction, and return without waiting for it.
+ *                   Transactions are performed in the order of submission.
+ * Parameters      : transaction (I) Transaction to perform.
+ */
+void stdSpiSubmit( stdSpiTransaction_t transaction )
+{
+    if (!transaction->size) {
+        if (transaction->done) { stdSignalRaise(transaction->done); }
+        return;
+    }
+
+    transaction->next= Null;
+
+    stdXDisableInterrupts();
+    {
+        deviceSetup(transaction->device);
+
+        if (queueHead) {
+            queueTail->next= transaction;
+            queueTail      = transaction;
+        } else {
+            queueHead= transaction;
+            queueTail= transaction;
+            start();
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Exchange bytes with a device, blocking
+ *                   the calling thread until the transfer is complete.
+ * Parameters      : device     (I) Device to exchange with.
+ *                   tx         (I) Bytes to send, or Null for sending 0xff.
+ *                   rx         (O) Received bytes, or Null for discarding them.
+ *                   size       (I) Number of bytes.
+ */
+void stdSpiTransfer( stdSpiDevice_t device, const uInt8 *tx, uInt8 *rx, uInt16 size )
+{
+    stdInstantiateLocalSignal( done );
+    struct stdSpiTransactionRec  transaction;
+
+    transaction.device = device;
+    transaction.tx     = tx;
+    transaction.rx     = rx;
+    transaction.size   = size;
+    transaction.done   = &done;
+
+    stdSpiSubmit(&transaction);
+    stdSignalWait(&done, stdFOREVER);
+}
+
+
+/*
+ * Function        : Power down the SPI. No transactions
+ *                   should be queued anymore.
+ */
+void stdSpiTerm()
+{
+    SPCR  = 0;
+    PRR  |= (1<<PRSPI);
+}
@@ -0,0 +1,143 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides an interrupt driven master driver for the
+ *         hardware SPI. Transfers are described by transactions, which
+ *         are queued and then performed one after the other by the SPI
+ *         interrupt handler, so that several devices can share the bus
+ *         and threads need not busy wait on the transfer of each byte.
+ *
+ *         Pins: MOSI is PB3, MISO is PB4, SCK is PB5. SS (PB2) is made an
+ *         output, since otherwise the SPI may drop out of master mode.
+ *
+ *         Each device has its own chip select pin, SPI mode, bit order
+ *         and maximum clock frequency. The chip select pin is driven low
+ *         for the duration of each transaction, and high again afterwards;
+ *         this rising edge can also serve as the latch clock of shift
+ *         registers such as the 74HC595.
+ */
+
+#ifndef stdSpi_INCLUDED
+#define stdSpi_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include <avr/io.h>
+#include "stdTypes.h"
+#include "stdThreads.h"
+#include "stdBusDevice.h"
+
+/*---------------------------------- Types ----------------------------------*/
+
+/*
+ * SPI modes (clock polarity and phase)
+ * and bit order, as SPCR bits:
+ */
+#define stdSPI_MODE0       0
+#define stdSPI_MODE1       (1<<CPHA)
+#define stdSPI_MODE2       (1<<CPOL)
+#define stdSPI_MODE3       ((1<<CPOL)|(1<<CPHA))
+#define stdSPI_LSB_FIRST   (1<<DORD)
+
+/*
+ * Device on the SPI bus, see stdBusDevice.h:
+ */
+typedef struct stdSpiDeviceRec {
+    struct stdBusDeviceRec  bus;
+
+   /* private: */
+    uInt8                   spcr;
+    uInt8                   spsr;
+} *stdSpiDevice_t;
+
+/*
+ * Function        : Define a device.
+ * Parameters      : name       (I) Name of the device.
+ *                   port       (I) Port letter of the chip select pin,
+ *                                  for instance B.
+ *                   pin        (I) Chip select pin number, for instance PB2.
+ *                   mode       (I) One of the stdSPI_MODEn, optionally
+ *                                  with stdSPI_LSB_FIRST.
+ *                   frequency  (I) Maximal SCK frequency in Hz.
+ */
+void stdInstantiateSpiDevice( String name, String port, uInt8 pin, uInt8 mode, uInt32 frequency );
+
+#define stdInstantiateSpiDevice(name,port,pin,mode,frequency) \
+           struct stdSpiDeviceRec name = { stdBUS_DEVICE(port,pin,mode,frequency), 0, 0 }
+
+
+/*
+ * Transfer of size bytes with device. When tx is Null, 0xff
+ * bytes are sent, and when rx is Null, received bytes are
+ * discarded. The done signal, when not Null, is raised when
+ * the transfer has completed. A transaction is owned by the
+ * driver from the moment that it is submitted until then:
+ */
+typedef struct stdSpiTransactionRec *stdSpiTransaction_t;
+
+struct stdSpiTransactionRec {
+    stdSpiTransaction_t  next;
+    stdSpiDevice_t       device;
+    const uInt8         *tx;
+    uInt8               *rx;
+    uInt16               size;
+    stdSignal_t          done;
+};
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Power up the SPI as master.
+ */
+void stdSpiInit();
+
+
+/*
+ * Function        : Make the chip select pin of a device an output,
+ *                   and deselect the device.
+ * Parameters      : device     (I) Device to set up.
+ */
+void stdSpiAttach( stdSpiDevice_t device );
+
+#define stdSpiAttach(device)   stdBusAttach(&(device)->bus)
+
+
+/*
+ * Function        : Queue a transaction, and return without waiting for it.
+ *                   Transactions are performed in the order of submission.
+ * Parameters      : transaction (I) Transaction to perform.
+ */
+void stdSpiSubmit( stdSpiTransaction_t transaction );
+
+
+/*
+ * Function        : Exchange bytes with a device, blocking
+ *                   the calling thread until the transfer is complete.
+ * Parameters      : device     (I) Device to exchange with.
+ *                   tx         (I) Bytes to send, or Null for sending 0xff.
+ *                   rx         (O) Received bytes, or Null for discarding them.
+ *                   size       (I) Number of bytes.
+ */
+void stdSpiTransfer( stdSpiDevice_t device, const uInt8 *tx, uInt8 *rx, uInt16 size );
+
+
+/*
+ * Function        : Power down the SPI. No transactions
+ *                   should be queued anymore.
+ */
+void stdSpiTerm();
+
+#endif
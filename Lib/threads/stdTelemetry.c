@@ -0,0 +1,130 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements framed binary telemetry.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include <util/crc16.h>
+
+#include "stdThreads.h"
+#include "stdTelemetry.h"
+#include "uart.h"
+
+/*------------------------------- Module State ------------------------------*/
+
+/*
+ * Frame encoding state; the frame being encoded
+ * is owned by the thread holding frameLock.
+ * The encoding of n bytes takes at most
+ * n + 1 + n/254 bytes, plus the delimiter:
+ */
+#define FRAME_MAX   (2 + stdTELEMETRY_MAX + 2)
+
+static stdInstantiateMutex( frameLock );
+
+static uInt8   frame[FRAME_MAX + 1 + FRAME_MAX/254 + 1];
+static uInt8   frameFill;
+static uInt8   codeIndex;
+static uInt16  frameCRC;
+static uInt8   sequence;
+
+/*------------------------------ COBS Encoding ------------------------------*/
+
+    static void frameStart()
+    {
+        codeIndex = 0;
+        frameFill = 1;
+        frameCRC  = 0xffff;
+    }
+
+    static void frameClose( uInt8 code )
+    {
+        frame[codeIndex]= code;
+        codeIndex       = frameFill++;
+    }
+
+   /*
+    * Add a byte to the frame, without
+    * updating the CRC:
+    */
+    static void framePutRaw( uInt8 b )
+    {
+        if (b == 0) {
+            frameClose(frameFill - codeIndex);
+        } else {
+            frame[frameFill++]= b;
+
+            if (frameFill - codeIndex == 0xff) {
+                frameClose(0xff);
+            }
+        }
+    }
+
+    static void framePut( uInt8 b )
+    {
+        frameCRC= _crc_xmodem_update(frameCRC, b);
+        framePutRaw(b);
+    }
+
+    static void frameEnd()
+    {
+        uInt16 crc= frameCRC;
+
+        framePutRaw(crc & 0xff);
+        framePutRaw(crc >> 8);
+
+        frame[codeIndex]  = frameFill - codeIndex;
+        frame[frameFill++]= 0;
+    }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Send a record as one frame, via the uart transmit
+ *                   buffer. Frames of different threads do not interleave.
+ * Parameters      : type       (I) Record type.
+ *                   record     (I) Record contents.
+ *                   size       (I) Size of record in bytes.
+ * Function Result : False iff. size exceeds stdTELEMETRY_MAX.
+ */
+Bool stdTelemetrySend( uInt8 type, const void *record, uInt8 size )
+{
+    const uInt8 *bytes= record;
+
+    if (size > stdTELEMETRY_MAX) {
+        return False;
+    }
+
+    stdMutexEnter(&frameLock);
+    {
+        frameStart();
+        framePut(sequence++);
+        framePut(type);
+
+        while (size--) {
+            framePut(*bytes++);
+        }
+
+        frameEnd();
+
+        uart_write_chars((const char*)frame, frameFill);
+    }
+    stdMutexExit(&frameLock);
+
+    return True;
+}
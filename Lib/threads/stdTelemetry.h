@@ -0,0 +1,60 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API sends typed binary telemetry records over the uart,
+ *         for decoding by Tools/telemetry.py. Each record becomes one
+ *         frame:
+ *
+ *             sequence number   1 byte, incremented per frame
+ *             record type       1 byte, defined by the application
+ *             record            0..stdTELEMETRY_MAX bytes, as in memory
+ *                               (that is, little endian)
+ *             CRC-16            2 bytes little endian, CCITT polynomial 
+ *                               0x1021 with initial value 0xffff, over
+ *                               all preceding bytes of the frame
+ *
+ *         which is COBS encoded and terminated by a zero byte, so that
+ *         a receiver can resynchronize at any zero. Gaps in the sequence
+ *         numbers reveal lost frames.
+ */
+
+#ifndef stdTelemetry_INCLUDED
+#define stdTelemetry_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include "stdTypes.h"
+
+/*-------------------------------- Constants --------------------------------*/
+
+/*
+ * Maximum record size:
+ */
+#define stdTELEMETRY_MAX   64
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Send a record as one frame, via the uart transmit
+ *                   buffer. Frames of different threads do not interleave.
+ * Parameters      : type       (I) Record type.
+ *                   record     (I) Record contents.
+ *                   size       (I) Size of record in bytes.
+ * Function Result : False iff. size exceeds stdTELEMETRY_MAX.
+ */
+Bool stdTelemetrySend( uInt8 type, const void *record, uInt8 size );
+
+#endif
@@ -21,28 +21,131 @@
 
 #include "stdThreads.h"
 #include "stdDefs.h"
+#include "eeprom.h"
+
+#include <avr/wdt.h>
 
 /*------------------------------- Module State ------------------------------*/
 
 /*
  * Number of ticks that task can 
- * run before it will be yielded:
+ * run before it will be yielded,
+ * unless it has a quota of its own:
  */
 #define TIME_SLICE_QUOTA    4
 
+#define QUOTA(thread)       ((thread)->quota ? (thread)->quota : TIME_SLICE_QUOTA)
+
+/*
+ * Thread flags:
+ */
+#define TF_TIMED            0x01    // thread is in timerQ
+#define TF_TIMEDOUT         0x02    // wait was ended by timerQ
+#define TF_EVENTS_ALL       0x04    // stdEVENTS_ALL event wait
+#define TF_EVENTS_CLEAR     0x08    // stdEVENTS_CLEAR event wait
+#define TF_EVENTS_SHIFT        2
+#define TF_DEADLINE         0x10    // thread has a deadline
+#define TF_EXITED           0x20    // thread has terminated
+
+/*
+ * EEPROM location for recording 
+ * the id of a failed heartbeat:
+ */
+#ifndef stdWATCHDOG_EEPROM_ADDRESS
+#define stdWATCHDOG_EEPROM_ADDRESS   E2END
+#endif
+
+/*
+ * Kernel ticks between heartbeat checks:
+ */
+#if stdSECOND >= 8
+#define HEARTBEAT_CHECK_PERIOD  (stdSECOND/8)
+#else
+#define HEARTBEAT_CHECK_PERIOD  1
+#endif
+
+/*
+ * Task flags:
+ */
+#define TASK_POSTED         0x01    // task is in its runner's readyQ
+#define TASK_TIMED          0x02    // task is in taskTimerQ
+
+/*
+ * Size of the stack of the idle context, which
+ * runs the idle hooks and the interrupt handlers
+ * that occur while no thread is runnable:
+ */
+#ifndef stdIDLE_STACK_SIZE
+#define stdIDLE_STACK_SIZE   128
+#endif
+
+/*
+ * Registration of a thread waiting in stdWaitAny
+ * on a semaphore. These are allocated on the 
+ * waiting thread's stack:
+ */
+struct stdWatchRec {
+    struct stdWatchRec  *next;
+    stdThread_t          thread;
+};
+
 static ThreadPrioQ_t  timerQ         = Null;
+static stdIdleHook_t  idleHooks      = Null;
+static stdIdleHook_t  idleCursor     = Null;
+static stdHeartbeat_t heartbeats     = Null;
+static Bool           watchdogOn     = False;
+static uInt8          watchdogCount  = HEARTBEAT_CHECK_PERIOD;
+static uInt8          resetCause     = 0;
+static stdTask_t      taskTimerQ     = Null;
 static uInt16         kernelTicks    = 0;
 static Bool           sleepPrevent   = False;
+static stdClockHook_t clockHooks     = Null;
+static uInt8          clockShift     = 0;
+static uInt8          clockDivider   = 0;
+static uInt8          clockBoosts    = 0;
        Bool           stdSchedLock   = False;
+       volatile uInt8 stdSchedNesting  = 0;
+       volatile Bool  stdSchedHeldBack = False;
 
 /*------------------------- Prioritized Task Queues -------------------------*/
 
-static void enQueue( ThreadPrioQ_t *queue, stdThread_t thread )
+#ifdef THREADS_SCHEDULING_EDF
+   /*
+    * Earliest deadline first: threads with a deadline 
+    * are ordered by deadline, and go before threads 
+    * without one. Priority breaks the remaining ties:
+    */
+    static Bool moreUrgent( stdThread_t a, stdThread_t b )
+    {
+        if ( (a->flags & TF_DEADLINE) != (b->flags & TF_DEADLINE) ) {
+            return (a->flags & TF_DEADLINE) != 0;
+        } else
+        if ( (a->flags & TF_DEADLINE) && a->deadline != b->deadline ) {
+            return (Int16)(a->deadline - b->deadline) < 0;
+        } else {
+            return a->priority > b->priority;
+        }
+    }
+#else
+    #define moreUrgent(a,b)   ((a)->priority > (b)->priority)
+#endif
+
+/*
+ * Decide whether thread may preempt running thread self,
+ * taking its preemption threshold into account:
+ */
+static Bool preempts( stdThread_t thread, stdThread_t self )
 {
-    uInt8 priority= thread->priority;                    
+    return moreUrgent(thread,self)
+        && ( self->threshold <= self->priority
+          || thread->priority > self->threshold
+           );
+}
 
+static void enQueue( ThreadPrioQ_t *queue, stdThread_t thread )
+{
     while ( (*queue) 
-         && (*queue)->priority >= priority
+         && !moreUrgent(thread,*queue)
       ) { 
         queue= &((*queue)->next); 
     }
@@ -51,10 +154,117 @@ static void enQueue( ThreadPrioQ_t *queue, stdThread_t thread )
    *queue        = thread;                                                   
 }
 
+static void unQueue( ThreadPrioQ_t *queue, stdThread_t thread )
+{
+    while ( (*queue) != thread ) { 
+        queue= &((*queue)->next); 
+    }
+    
+   *queue= thread->next;
+}
+
 #define QUEUEHEAD(queue)         queue
 #define DEQUEUE(queue)           queue= queue->next;
 #define ENQUEUE(queue,thread)    enQueue( &(queue), thread );
 
+/*
+ * Insert a thread into the run queue. Threads that may
+ * not preempt the current thread, due to the thread level
+ * scheduler lock or to the current thread's preemption 
+ * threshold, are queued behind it. This keeps the current
+ * thread at the head of the run queue while it is running:
+ */
+static void makeRunnable( stdThread_t thread )
+{
+    stdThread_t  self= stdCurrentThread;
+
+    if ( self == stdRunQ
+      && ( stdSchedNesting || !preempts(thread,self) )
+       ) {
+        if (stdSchedNesting) {
+            stdSchedHeldBack= True;
+        }
+
+        enQueue( &self->next, thread );
+    } else {
+        enQueue( &stdRunQ, thread );
+    }
+}
+
+/*
+ * Reposition the current thread in the run queue after
+ * its scheduler lock, preemption threshold or deadline 
+ * changed, so that more urgent threads that were queued 
+ * behind it get ahead. It stays ahead of equally urgent
+ * threads:
+ */
+static void requeueCurrent()
+{
+    stdThread_t  self = stdCurrentThread;
+
+    if (self == stdRunQ) {
+        ThreadPrioQ_t *queue = &stdRunQ;
+
+        DEQUEUE(stdRunQ);
+
+        while ( (*queue) 
+             && preempts(*queue,self)
+          ) { 
+            queue= &((*queue)->next); 
+        }
+
+        self->next = *queue;                                             
+       *queue      = self;                                                   
+    }
+}
+
+/*----------------------------- Delta Time Queue ----------------------------*/
+
+/*
+ * The timer queue is linked via field timerNext,
+ * so that a thread can be in the timer queue while
+ * also being blocked in the wait queue of a signal,
+ * in which case it is waiting with a timeout.
+ * Each thread's ticks value is relative to that 
+ * of its predecessor:
+ */
+static void timerInsert( stdThread_t thread, uInt16 delay )
+{
+    ThreadPrioQ_t  *queue = &timerQ;
+
+    while ( (*queue) 
+         && (*queue)->ticks <= delay
+          ) { 
+        delay -= (*queue)->ticks;
+        queue= &((*queue)->timerNext); 
+    }
+
+    if (*queue) {
+        (*queue)->ticks -= delay;
+    }
+
+    thread->ticks     = delay;
+    thread->timerNext = *queue;                                             
+    thread->flags    |= TF_TIMED;
+   *queue             = thread;       
+}
+
+static void timerRemove( stdThread_t thread )
+{
+    ThreadPrioQ_t  *queue = &timerQ;
+
+    while ( (*queue) != thread ) { 
+        queue= &((*queue)->timerNext); 
+    }
+
+   *queue         = thread->timerNext;
+    thread->flags &= ~TF_TIMED;
+
+    if (*queue) {
+        (*queue)->ticks += thread->ticks;
+    }
+}
+
 /*
  * Function        : Prevent or allow processor going to sleep when idle.
  * Parameters      : preventSleep (I) When True, the processor will *not* go
@@ -77,6 +287,108 @@ Bool stdSleepPrevent( Bool preventSleep )
     return result;
 }
 
+/*-------------------------------- Idle Hooks -------------------------------*/
+
+   /*
+    * Call the next pending idle hook, round robin, with 
+    * interrupts enabled. Called by the idle context with 
+    * interrupts disabled. Returns False iff. no hook 
+    * was pending:
+    */
+    static Bool runIdleHook()
+    {
+        stdIdleHook_t hook, start;
+
+        if (!idleHooks) {
+            return False;
+        }
+
+        hook  = idleCursor ? idleCursor : idleHooks;
+        start = hook;
+
+        do {
+            if (hook->pending) {
+                Bool more;
+
+                idleCursor    = hook->next;
+                hook->pending = False;
+
+                stdXEnableInterrupts();
+                {
+                    more= hook->fun();
+                }
+                stdXDisableInterrupts();
+
+                if (more) {
+                    hook->pending= True;
+                }
+
+                return True;
+            }
+
+            hook= hook->next ? hook->next : idleHooks;
+        } while (hook != start);
+
+        return False;
+    }
+
+
+/*
+ * Function        : Add/remove an idle hook to/from the kernel. 
+ *                   Hooks are added as pending; adding a hook
+ *                   that was already added only marks it pending.
+ * Parameters      : hook       (I) Idle hook to add or remove.
+ */        
+void stdIdleHookAdd( stdIdleHook_t hook )
+{
+    stdXDisableInterrupts();
+    {
+        stdIdleHook_t h= idleHooks;
+
+        while (h && h != hook) {
+            h= h->next;
+        }
+
+        if (!h) {
+            hook->next    = idleHooks;
+            idleHooks     = hook;
+        }
+
+        hook->pending = True;
+    }
+    stdXEnableInterrupts();
+}
+
+void stdIdleHookRemove( stdIdleHook_t hook )
+{
+    stdXDisableInterrupts();
+    {
+        stdIdleHook_t *queue= &idleHooks;
+
+        while (*queue && *queue != hook) {
+            queue= &((*queue)->next);
+        }
+
+        if (*queue) {
+           *queue      = hook->next;
+            idleCursor = Null;
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Mark idle hook as having work to do.
+ *                   This function may also be called from interrupt handlers.
+ * Parameters      : hook       (I) Idle hook to post.
+ */        
+void stdIdleHookPost( stdIdleHook_t hook )
+{
+    hook->pending= True;
+}
+
+
 /*--------------------------- Scheduling Functions --------------------------*/
 
         #define ALL_DEVICES ( (1<<PRTWI) | (1<<PRTIM2) | (1<<PRTIM1) | (1<<PRTIM0) | (1<<PRSPI) | (1<<PRUSART0) | (1<<PRADC) )
@@ -110,7 +422,9 @@ Bool stdSleepPrevent( Bool preventSleep )
             *       appears to work fine.
             */
             if ( ( (PRR
-                     #if !defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz)
+                     #if defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)  \
+                      || defined(THREADS_SYSTEM_CLOCK_FREQ_32kHz) \
+                      || defined(THREADS_SYSTEM_TIMER_ASYNC)
                         |(1<<PRTIM2)
                      #endif
                    ) == ALL_DEVICES )
@@ -119,6 +433,19 @@ Bool stdSleepPrevent( Bool preventSleep )
               &&  (!sleepPrevent)
                )
                {
+               /*
+                * The timer interrupt rewrote TCCR2A; the
+                * asynchronous timer only recognizes its next
+                * compare match after that write has been
+                * synchronized (see Section 17.9 of the ATMega328 
+                * data sheet). That normally completed long ago,
+                * so doing this here instead of in the interrupt
+                * keeps ticks short:
+                */
+               #if defined(THREADS_SYSTEM_TIMER_ASYNC)
+                while (ASSR & (1<<TCR2AUB)) {}
+               #endif
+               
                 // power save
                 SMCR = (1<<SE) | (1<<SM1) | (1<<SM0);
             } else {
@@ -137,26 +464,59 @@ Bool stdSleepPrevent( Bool preventSleep )
         }
 
 
+/*
+ * The idle context runs whenever the run queue is empty,
+ * on a stack of its own. It is not in the run queue, so any
+ * thread made runnable by an interrupt preempts it via 
+ * stdReschedule, even in the middle of an idle hook; that
+ * hook then continues when the run queue is empty again,
+ * regardless of which thread blocked last:
+ */
+static void idleLoop();
+
+static Byte                 idleStack[stdIDLE_STACK_SIZE];
+static struct stdThreadRec  idleContext= { 
+                                .context= { {0}, (uInt16)&idleStack[stdIDLE_STACK_SIZE-1], 0, idleLoop } 
+                            };
+
+/*
+ * Spin until the run queue becomes non-empty (due to 
+ * threads made runnable by some interrupt), calling
+ * pending idle hooks and otherwise sleeping, and then 
+ * switch to the head of the run queue. Runs with 
+ * interrupts disabled, except in the hooks and in SLEEP:
+ */
+static void idleLoop()
+{
+    while (True) {
+        while (!stdRunQ) {
+            if (!runIdleHook()) {
+                SLEEP();
+            }
+        }
+
+        if (!setjmp(*(jmp_buf*)&idleContext.context)) {
+            stdCurrentThread= QUEUEHEAD(stdRunQ);
+            longjmp(*(jmp_buf*)&stdCurrentThread->context,1);
+        }
+    }
+}
+
+
 /*
  * The following scheduling functions are called 
- * with interrupts disabled. The first one spins 
- * until the run queue becomes non-empty (due to
- * threads made runnable by some interrupt). 
- * While spinning, the interrupts are periodically
- * enabled to allow serving interrupts.
+ * with interrupts disabled. The first one switches
+ * to the head of the run queue, or to the idle 
+ * context when the run queue is empty:
  */
 static void deschedule()
 {
     stdThread_t self= stdCurrentThread;
 
     if (!setjmp(*(jmp_buf*)&self->context)) {
+        stdCurrentThread= stdRunQ ? QUEUEHEAD(stdRunQ) : &idleContext;
 
-        while (!stdRunQ) {
-            SLEEP();
-        }
-
-        if ( stdRunQ != self ) {
-            stdCurrentThread= QUEUEHEAD(stdRunQ);
+        if (stdCurrentThread != self) {
             longjmp(*(jmp_buf*)&stdCurrentThread->context,1);
         }
     }
@@ -176,6 +536,49 @@ void stdReschedule()
 }
 
 
+/*
+ * Block the current thread in the specified wait queue,
+ * optionally with a timeout. Called with interrupts disabled.
+ * Returns False iff. the wait timed out:
+ */
+static Bool block( ThreadPrioQ_t *queue, uInt16 timeout )
+{
+    stdThread_t  self= stdCurrentThread;
+
+    DEQUEUE(stdRunQ);
+    enQueue(queue,self);
+
+    self->waitQ  = queue;
+    self->flags &= ~TF_TIMEDOUT;
+
+    if (timeout) {
+        timerInsert(self,timeout);
+    }
+
+    deschedule();   
+
+    return !(self->flags & TF_TIMEDOUT);
+}
+
+
+/*
+ * Make a thread that was just removed from 
+ * its wait queue runnable again, cancelling its
+ * timeout if it has one. Called with interrupts disabled.
+ */
+static void wakeUp( stdThread_t thread )
+{
+    if (thread->flags & TF_TIMED) {
+        timerRemove(thread);
+    }
+
+    thread->waitQ= Null;
+
+    makeRunnable(thread);
+    thread->ticks= QUOTA(thread);
+}
+
+
 /*----------------------------- Thread Functions ----------------------------*/
 
 
@@ -213,9 +616,11 @@ void stdThreadResume( stdThread_t thread )
 {
     stdXDisableInterrupts();
     {
-        if (++thread->runCount == 1) { 
-            ENQUEUE(stdRunQ,thread);
-            thread->ticks= TIME_SLICE_QUOTA;
+        if ( !(thread->flags & TF_EXITED)
+          && ++thread->runCount == 1
+           ) { 
+            makeRunnable(thread);
+            thread->ticks= QUOTA(thread);
             stdReschedule();   
         }
     }
@@ -223,103 +628,1529 @@ void stdThreadResume( stdThread_t thread )
 }
 
 
-/*--------------------------- Semaphore Functions ---------------------------*/
+// Initial function of threads
+void stdThreadStart()
+{
+    stdThread_t self= stdCurrentThread;
 
-/* 
- * Function        : Acquire semaphore or wait.
- *                   If the semaphore's count is currently equal to zero,
- *                   then wait until this count increases.
- * Parameters      : sem (I) Semaphore to acquire.
+    ((void (*)(Pointer))self->entry)(self->arg);
+
+    stdThreadExit();
+}
+
+
+/*
+ * Function        : Terminate the current thread, waking up all threads
+ *                   that are joining it. This function does not return.
+ *                   Resuming an exited thread has no effect.
  */        
-void stdSemP (stdSem_t sem)
+void stdThreadExit()
 {
-    Bool canDo;
+    stdThread_t self= stdCurrentThread;
 
     stdXDisableInterrupts();
-    {
-        canDo= sem->count > 0;
-    
-        if (canDo) {
-            sem->count--;
-        } else {
 
-            stdThread_t  self= stdCurrentThread;
-                    
-            DEQUEUE(stdRunQ);
-            ENQUEUE(sem->waitQ,self);
+    self->flags |= TF_EXITED;
 
-            deschedule();   
-        }
+   /*
+    * Leave the run queue before waking the joiners,
+    * so that these are not queued ahead of this thread
+    * and then dequeued in its place:
+    */
+    DEQUEUE(stdRunQ);
+
+    while (self->joinQ) {
+        stdThread_t joiner= QUEUEHEAD(self->joinQ);
+
+        DEQUEUE(self->joinQ);
+        wakeUp(joiner);
     }
-    stdXEnableInterrupts();
-}
 
+   /*
+    * Leave for good; the stack is not used 
+    * anymore once another thread was switched to:
+    */
+    deschedule();   
 
+    while (True) {}
+}
 
 
-/* 
- * Function        : Acquire semaphor or fail.
- *                   Try to acquire a semaphore, and return
- *                   immediate failure if the semaphore's 
- *                   count is currently equal to zero.
- * Parameters      : sem (I) Semaphore to acquire.
- * Function Result : True iff. operation succeeded.
+/*
+ * Function        : Wait until a thread has exited.
+ * Parameters      : thread     (I) Thread to wait for.
+ *                   timeout    (I) Maximum amount of kernel clock ticks
+ *                                  to wait, or stdFOREVER.
+ * Function Result : True iff. the thread has exited; False when the wait
+ *                   timed out.
  */        
-Bool stdSemTryP (stdSem_t sem)
+Bool stdThreadJoin( stdThread_t thread, uInt16 timeout )
 {
-    Bool canDo;
+    Bool result= True;
 
     stdXDisableInterrupts();
     {
-        canDo= sem->count > 0;
-    
-        if (canDo) { 
-            sem->count--; 
+        if (!(thread->flags & TF_EXITED)) {
+            result= block(&thread->joinQ, timeout);
         }
     }
     stdXEnableInterrupts();
-    
-    return canDo;
-}
-
 
+    return result;
+}
 
 
-/* 
- * Function        : Release semaphore.
- * Parameters      : sem (I) Semaphore to release.
+/*
+ * Function        : Start a job in a free slot of a thread pool. A slot is 
+ *                   free when it was never used, or when its previous thread
+ *                   has exited. 
+ *                   NB: a thread that has exited may thus be restarted for
+ *                       another job; joining it is only meaningful while
+ *                       the job's owner controls reuse of the pool.
+ * Parameters      : pool       (I) Pool to start the job in.
+ *                   fun        (I) Function to execute, called with arg.
+ *                   arg        (I) Argument for fun.
+ *                   prio       (I) Thread priority (higher is more urgent).
+ * Function Result : The started thread, or Null when no slot was free.
  */        
-void stdSemV (stdSem_t sem)
+stdThread_t stdThreadPoolStart( stdThreadPool_t pool, Pointer fun, Pointer arg, uInt8 prio )
 {
+    stdThread_t result= Null;
+    uInt8       i;
+
     stdXDisableInterrupts();
     {
-        stdThread_t revived= QUEUEHEAD(sem->waitQ);
-    
-        if (sem->count == 0 && revived) {
-            DEQUEUE(sem->waitQ);
-            ENQUEUE(stdRunQ,revived);
-            revived->ticks= TIME_SLICE_QUOTA;
-        
-            stdReschedule();   
-        } else {
-            sem->count++;
+        for (i=0; i<pool->size; i++) {
+            stdThread_t thread= &pool->threads[i];
+
+           /*
+            * Never used slots are still all zero:
+            */
+            if ( !thread->context.pc 
+              || (thread->flags & TF_EXITED)
+               ) {
+                thread->priority   = prio;
+                thread->runCount   = 1;
+                thread->flags      = 0;
+                thread->waitQ      = Null;
+                thread->threshold  = 0;
+                thread->misses     = 0;
+                thread->entry      = (stdPC)fun;
+                thread->arg        = arg;
+                thread->context.sp = (uInt16)&pool->stacks[ (i+1)*pool->ssize - 1 ];
+                thread->context.sr = (1<<SREG_I);
+                thread->context.pc = stdThreadStart;
+                thread->quota      = stdQUOTA_DEFAULT;
+                thread->ticks      = TIME_SLICE_QUOTA;
+
+                makeRunnable(thread);
+                stdReschedule();   
+
+                result= thread;
+                break;
+            }
         }
     }
     stdXEnableInterrupts();
+
+    return result;
 }
 
-/*------------------------------ Time Functions -----------------------------*/
 
-   /*
-    * Function        : Timer interrupt handler,
-    *                   must be called at stdSECOND Hz.
+/*
+ * Function        : Let other runnable threads of the same priority run
+ *                   before continuing the current thread. This is the way
+ *                   for equally urgent threads to share the processor when
+ *                   timeslicing is disabled, either per thread or by 
+ *                   compiling with THREADS_TIMESLICE_COOPERATIVE. 
+ *                   Does nothing while holding the scheduler lock.
+ */        
+void stdThreadYield()
+{
+    stdThread_t self= stdCurrentThread;
+
+    stdXDisableInterrupts();
+    {
+        if (!stdSchedNesting) {
+            DEQUEUE(stdRunQ);
+            ENQUEUE(stdRunQ, self);
+            self->ticks= QUOTA(self);
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Set time slice quota of a thread: the amount of kernel
+ *                   clock ticks that it may run before other runnable threads
+ *                   of the same priority get their turn. Threads are created
+ *                   with quota stdQUOTA_DEFAULT, which is 4 ticks. The new
+ *                   quota takes effect from the thread's next time slice.
+ *                   When compiled with THREADS_TIMESLICE_COOPERATIVE, 
+ *                   no thread is timesliced, and quotas have no effect.
+ * Parameters      : thread     (I) Thread to set the quota of.
+ *                   quota      (I) Amount of kernel clock ticks, 
+ *                                  stdQUOTA_DEFAULT, or stdQUOTA_NEVER for 
+ *                                  running until blocking or yielding.
+ * Function Result : Old quota.
+ */        
+uInt8 stdThreadSetQuota( stdThread_t thread, uInt8 quota )
+{
+    uInt8 result;
+
+    stdXDisableInterrupts();
+    {
+        result        = thread->quota;
+        thread->quota = quota;
+    }
+    stdXEnableInterrupts();
+
+    return result;
+}
+
+
+/*
+ * Function        : Set preemption threshold of the current thread.
+ *                   While running, the current thread can only be preempted
+ *                   by threads with a priority higher than its threshold
+ *                   (or its priority, when that is higher). Threads running
+ *                   with a raised threshold are not timesliced.
+ *                   Threads are created with a threshold of 0.
+ * Parameters      : threshold  (I) New preemption threshold.
+ * Function Result : Old preemption threshold.
+ */        
+uInt8 stdThreadSetThreshold( uInt8 threshold )
+{
+    stdThread_t self= stdCurrentThread;
+    uInt8       result;
+
+    stdXDisableInterrupts();
+    {
+        result          = self->threshold;
+        self->threshold = threshold;
+
+        if (threshold < result && !stdSchedNesting) {
+            requeueCurrent();
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+
+    return result;
+}
+
+
+/*
+ * Complete the current job of the thread, if it
+ * has one, counting a miss when this is after its
+ * deadline:
+ */
+static void checkDeadline( stdThread_t thread )
+{
+    if ( (thread->flags & TF_DEADLINE)
+      && (Int16)(kernelTicks - thread->deadline) > 0
+      && thread->misses != 0xff
+       ) {
+        thread->misses++;
+    }
+}
+
+
+/*
+ * Function        : Start a new job of the current thread, which should
+ *                   complete within the specified amount of time. 
+ *                   When compiled with THREADS_SCHEDULING_EDF, threads with
+ *                   a deadline are scheduled earliest deadline first, ahead 
+ *                   of all threads without one. Otherwise, deadlines are 
+ *                   only used for counting deadline misses.
+ *                   Calling this function completes the previous job of the
+ *                   thread, if any, and counts a miss when this happens after
+ *                   the previous job's deadline. Threads that block between
+ *                   jobs should complete each job with stdFOREVER before
+ *                   blocking, since otherwise the time spent blocked counts
+ *                   as part of the job.
+ * Parameters      : deadline   (I) Relative deadline in kernel clock ticks, 
+ *                                  or stdFOREVER for removing the deadline. 
+ */        
+void stdThreadSetDeadline( uInt16 deadline )
+{
+    stdThread_t self= stdCurrentThread;
+
+    stdXDisableInterrupts();
+    {
+        checkDeadline(self);
+
+        if (deadline == stdFOREVER) {
+            self->flags    &= ~TF_DEADLINE;
+        } else {
+            self->deadline  = kernelTicks + deadline;
+            self->flags    |= TF_DEADLINE;
+        }
+
+        if (!stdSchedNesting) {
+            requeueCurrent();
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Complete the current job of a periodic thread, and wait 
+ *                   for the release of its next job. The next job is released
+ *                   at the current deadline, and gets a deadline one period 
+ *                   later, so that the thread keeps its phase. A miss is 
+ *                   counted when the current job completed after its deadline.
+ *                   The first call on a thread without deadline releases its 
+ *                   next job immediately.
+ * Parameters      : period     (I) Period in kernel clock ticks.
+ */        
+void stdThreadWaitPeriod( uInt16 period )
+{
+    stdThread_t self= stdCurrentThread;
+
+    stdXDisableInterrupts();
+    {
+        uInt16 release= kernelTicks;
+
+        if (self->flags & TF_DEADLINE) {
+            checkDeadline(self);
+            release= self->deadline;
+        }
+
+        self->deadline  = release + period;
+        self->flags    |= TF_DEADLINE;
+
+        if ( (Int16)(release - kernelTicks) > 0 ) {
+            DEQUEUE(stdRunQ);
+            timerInsert(self, release - kernelTicks);
+
+            deschedule();   
+        } else
+        if (!stdSchedNesting) {
+            requeueCurrent();
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Get the number of deadline misses of a thread.
+ * Parameters      : thread     (I) Thread to inspect.
+ * Function Result : Number of jobs that completed after their deadline,
+ *                   saturating at 255.
+ */        
+uInt8 stdThreadDeadlineMisses( stdThread_t thread )
+{
+    return thread->misses;
+}
+
+
+// Used by stdSchedulerUnlock
+void stdSchedRelease()
+{
+    stdXDisableInterrupts();
+    {
+        stdSchedHeldBack= False;
+
+        requeueCurrent();
+        stdReschedule();   
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*------------------------- Run-to-completion Tasks -------------------------*/
+
+   /*
+    * Insert task in its runner's ready queue, and make 
+    * the runner compete at the priority of its most urgent 
+    * task. Interrupts must be disabled. Returns whether 
+    * rescheduling is needed:
+    */
+    static Bool taskPost( stdTask_t task )
+    {
+        stdTaskRunner_t  runner = task->runner;
+        stdThread_t      thread = &runner->thread;
+        stdTask_t       *queue  = &runner->readyQ;
+        Bool             idle   = !runner->readyQ && !runner->busy;
+
+        if (task->flags & TASK_POSTED) {
+            return False;
+        }
+
+        task->flags |= TASK_POSTED;
+
+        while ( (*queue) 
+             && (*queue)->priority >= task->priority
+          ) { 
+            queue= &((*queue)->next); 
+        }
+
+        task->next = *queue;                                             
+       *queue      = task;                                                   
+
+        if (idle) {
+            thread->priority= task->priority;
+            wakeUp(thread);
+            return True;
+        } else
+        if (task->priority > thread->priority) {
+            thread->priority= task->priority;
+
+            if (thread != QUEUEHEAD(stdRunQ)) {
+                unQueue(&stdRunQ, thread);
+                makeRunnable(thread);
+            }
+            return True;
+        } else {
+            return False;
+        }
+    }
+
+    static void taskTimerInsert( stdTask_t task, uInt16 delay )
+    {
+        stdTask_t  *queue = &taskTimerQ;
+
+        while ( (*queue) 
+             && (*queue)->ticks <= delay
+              ) { 
+            delay -= (*queue)->ticks;
+            queue= &((*queue)->timerNext); 
+        }
+
+        if (*queue) {
+            (*queue)->ticks -= delay;
+        }
+
+        task->ticks     = delay;
+        task->timerNext = *queue;                                             
+        task->flags    |= TASK_TIMED;
+       *queue           = task;       
+    }
+
+    static void taskTimerRemove( stdTask_t task )
+    {
+        stdTask_t  *queue = &taskTimerQ;
+
+        while ( (*queue) != task ) { 
+            queue= &((*queue)->timerNext); 
+        }
+
+       *queue       = task->timerNext;
+        task->flags &= ~TASK_TIMED;
+
+        if (*queue) {
+            (*queue)->ticks += task->ticks;
+        }
+    }
+
+
+// Thread function of task runners
+void stdTaskRun()
+{
+    stdTaskRunner_t runner= (stdTaskRunner_t)stdCurrentThread;
+
+    while (True) {
+        stdTask_t task;
+
+        stdXDisableInterrupts();
+        {
+            task= runner->readyQ;
+
+            if (task) {
+                runner->readyQ  = task->next;
+                runner->busy    = True;
+                task->flags    &= ~TASK_POSTED;
+
+               /*
+                * Give way to more urgent threads 
+                * when continuing with a less urgent task:
+                */
+                if (task->priority < runner->thread.priority) {
+                    runner->thread.priority= task->priority;
+
+                    if (!stdSchedNesting) {
+                        requeueCurrent();
+                        stdReschedule();   
+                    }
+                }
+            } else {
+                runner->busy= False;
+
+                DEQUEUE(stdRunQ);
+                deschedule();
+            }
+        }
+        stdXEnableInterrupts();
+
+        if (task) {
+            task->fun(task->arg);
+        }
+    }
+}
+
+
+/*
+ * Function        : Post task for execution by its runner.
+ *                   This function may also be called from interrupt handlers.
+ * Parameters      : task       (I) Task to post.
+ */        
+void stdTaskPost( stdTask_t task )
+{
+    stdXDisableInterrupts();
+    {
+        if (taskPost(task)) {
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Post task after a delay, and optionally periodically 
+ *                   thereafter. This replaces a previously started timer.
+ * Parameters      : task       (I) Task to post.
+ *                   delay      (I) Amount of kernel clock ticks until the
+ *                                  first post, or 0 for posting immediately.
+ *                   period     (I) Amount of kernel clock ticks between 
+ *                                  subsequent posts, or 0 for posting once.
+ */        
+void stdTaskStartTimer( stdTask_t task, uInt16 delay, uInt16 period )
+{
+    stdXDisableInterrupts();
+    {
+        if (task->flags & TASK_TIMED) {
+            taskTimerRemove(task);
+        }
+
+        task->period= period;
+
+        if (delay) {
+            taskTimerInsert(task, delay);
+        } else {
+            if (period) {
+                taskTimerInsert(task, period);
+            }
+
+            if (taskPost(task)) {
+                stdReschedule();   
+            }
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Cancel a task's timer, when started. 
+ *                   This does not affect an already posted task.
+ * Parameters      : task       (I) Task to stop posting.
+ */        
+void stdTaskStopTimer( stdTask_t task )
+{
+    stdXDisableInterrupts();
+    {
+        if (task->flags & TASK_TIMED) {
+            taskTimerRemove(task);
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Post task whenever a semaphore is released without
+ *                   waking a thread blocked in stdSemP, that is, whenever 
+ *                   its count is incremented. Queues can be used by means
+ *                   of stdQueueGetSem. The task should then consume the 
+ *                   available elements using stdSemTryP or stdQueueTryGet.
+ *                   The task is posted immediately when the semaphore
+ *                   is already available. A semaphore posts at most one task.
+ * Parameters      : sem        (I) Semaphore to watch.
+ *                   task       (I) Task to post, or Null to stop posting.
+ */        
+void stdSemSetTask( stdSem_t sem, stdTask_t task )
+{
+    stdXDisableInterrupts();
+    {
+        sem->task= task;
+
+        if (task && sem->count > 0 && taskPost(task)) {
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*--------------------------- Semaphore Functions ---------------------------*/
+
+/* 
+ * Function        : Acquire semaphore or wait.
+ *                   If the semaphore's count is currently equal to zero,
+ *                   then wait until this count increases.
+ * Parameters      : sem (I) Semaphore to acquire.
+ */        
+void stdSemP (stdSem_t sem)
+{
+    Bool canDo;
+
+    stdXDisableInterrupts();
+    {
+        canDo= sem->count > 0;
+    
+        if (canDo) {
+            sem->count--;
+        } else {
+            block(&sem->waitQ,stdFOREVER);
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+
+
+/* 
+ * Function        : Acquire semaphor or fail.
+ *                   Try to acquire a semaphore, and return
+ *                   immediate failure if the semaphore's 
+ *                   count is currently equal to zero.
+ * Parameters      : sem (I) Semaphore to acquire.
+ * Function Result : True iff. operation succeeded.
+ */        
+Bool stdSemTryP (stdSem_t sem)
+{
+    Bool canDo;
+
+    stdXDisableInterrupts();
+    {
+        canDo= sem->count > 0;
+    
+        if (canDo) { 
+            sem->count--; 
+        }
+    }
+    stdXEnableInterrupts();
+    
+    return canDo;
+}
+
+
+
+
+    /*
+     * Release semaphore without rescheduling.
+     * Called with interrupts disabled.
+     * Returns True iff. threads were made runnable:
+     */
+    static Bool semRelease (stdSem_t sem)
+    {
+        stdThread_t revived= QUEUEHEAD(sem->waitQ);
+
+        if (sem->count == 0 && revived) {
+            DEQUEUE(sem->waitQ);
+            wakeUp(revived);
+
+            return True;
+        } else {
+            struct stdWatchRec *watch  = sem->watchers;
+            Bool                woken  = False;
+
+            sem->count++;
+
+           /*
+            * Wake up threads in stdWaitAny;
+            * these can be found blocked in a wait queue
+            * on their own stack:
+            */
+            while (watch) {
+                stdThread_t watcher= watch->thread;
+
+                if (watcher->waitQ) {
+                    unQueue(watcher->waitQ, watcher);
+                    wakeUp(watcher);
+                    woken= True;
+                }
+
+                watch= watch->next;
+            }
+
+            if (sem->task && taskPost(sem->task)) {
+                woken= True;
+            }
+
+            return woken;
+        }
+    }
+
+/* 
+ * Function        : Release semaphore.
+ * Parameters      : sem (I) Semaphore to release.
+ */        
+void stdSemV (stdSem_t sem)
+{
+    stdXDisableInterrupts();
+    {
+        if (semRelease(sem)) {
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+/*---------------------------- Condition Variables --------------------------*/
+
+/* 
+ * Function        : Wait on condition variable.
+ *                   Atomically release the condition's mutex 
+ *                   and wait until the condition gets signalled;
+ *                   the mutex is held again when this function returns,
+ *                   also when the wait timed out.
+ *                   The calling thread must hold the mutex.
+ * Parameters      : cond    (I) Condition variable to wait on.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : True iff. the condition was signalled,
+ *                   False when the wait timed out.
+ */        
+Bool stdCondWait( stdCond_t cond, uInt16 timeout )
+{
+    Bool result;
+
+    stdXDisableInterrupts();
+    {
+        semRelease(cond->mutex);
+        result= block(&cond->waitQ,timeout);
+    }
+    stdXEnableInterrupts();
+
+   /*
+    * When signalled, the mutex has been
+    * handed over to us by condWake:
+    */
+    if (!result) {
+        stdSemP(cond->mutex);
+    }
+
+    return result;
+}
+
+
+    /*
+     * Hand the mutex over to a thread that was just 
+     * removed from the condition's wait queue, or let it wait 
+     * for the mutex when it is currently held.
+     * Called with interrupts disabled.
+     * Returns True iff. the thread was made runnable:
+     */
+    static Bool condWake( stdCond_t cond, stdThread_t waiter )
+    {
+        stdMutex_t mutex= cond->mutex;
+
+        if (mutex->count > 0) {
+            mutex->count--;
+            wakeUp(waiter);
+
+            return True;
+        } else {
+            if (waiter->flags & TF_TIMED) {
+                timerRemove(waiter);
+            }
+
+            enQueue(&mutex->waitQ, waiter);
+            waiter->waitQ= &mutex->waitQ;
+
+            return False;
+        }
+    }
+
+/* 
+ * Function        : Wake up the most urgent thread waiting on condition variable, if any.
+ *                   The calling thread should hold the condition's mutex.
+ * Parameters      : cond (I) Condition variable to signal.
+ */        
+void stdCondSignal( stdCond_t cond )
+{
+    stdXDisableInterrupts();
+    {
+        stdThread_t revived= QUEUEHEAD(cond->waitQ);
+
+        if (revived) {
+            DEQUEUE(cond->waitQ);
+
+            if (condWake(cond,revived)) {
+                stdReschedule();   
+            }
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/* 
+ * Function        : Wake up all threads waiting on condition variable.
+ *                   The calling thread should hold the condition's mutex.
+ * Parameters      : cond (I) Condition variable to signal.
+ */        
+void stdCondBroadcast( stdCond_t cond )
+{
+    stdXDisableInterrupts();
+    {
+        stdThread_t revived = QUEUEHEAD(cond->waitQ);
+        Bool        runnable= False;
+
+        while (revived) {
+            DEQUEUE(cond->waitQ);
+            runnable |= condWake(cond,revived);
+            revived   = QUEUEHEAD(cond->waitQ);
+        }
+
+        if (runnable) {
+            stdReschedule();   
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+/*---------------------------------- Signals --------------------------------*/
+
+/* 
+ * Function        : Wait until signal is raised, and consume it.
+ * Parameters      : signal  (I) Signal to wait for.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : True iff. the signal was raised, 
+ *                   False when the wait timed out.
+ */        
+Bool stdSignalWait( stdSignal_t signal, uInt16 timeout )
+{
+    Bool result= True;
+
+    stdXDisableInterrupts();
+    {
+        if (signal->raised) {
+            signal->raised= False;
+        } else {
+            result= block(&signal->waitQ,timeout);
+        }
+    }
+    stdXEnableInterrupts();
+
+    return result;
+}
+
+
+
+/* 
+ * Function        : Raise signal.
+ *                   This function may be called from interrupt handlers,
+ *                   either via stdRunISR or between stdISRLock/stdISRUnLock,
+ *                   and does not reenable interrupts.
+ * Parameters      : signal (I) Signal to raise.
+ */        
+void stdSignalRaise( stdSignal_t signal )
+{
+    stdIFlags intenable;
+
+    stdDisableInterrupts(&intenable);
+    {
+        stdThread_t revived= QUEUEHEAD(signal->waitQ);
+
+        if (revived) {
+            do {
+                DEQUEUE(signal->waitQ);
+                wakeUp(revived);
+                revived= QUEUEHEAD(signal->waitQ);
+            } while (revived);
+            
+            stdReschedule();   
+        } else {
+            signal->raised= True;
+        }
+    }
+    stdRestoreInterrupts(intenable);
+}
+
+
+
+/* 
+ * Function        : Clear a pending signal raise.
+ *                   To be used before arming the device that is 
+ *                   going to raise the signal, in case a previous
+ *                   raise might not have been consumed.
+ * Parameters      : signal (I) Signal to reset.
+ */        
+void stdSignalReset( stdSignal_t signal )
+{
+    signal->raised= False;
+}
+
+/*-------------------------------- Event Flags ------------------------------*/
+
+/*
+ * Return the bits in mask that are set in flags,
+ * or 0 if these do not satisfy the wait condition:
+ */
+static uInt8 eventsMatch( uInt8 flags, uInt8 mask, Bool all )
+{
+    uInt8 result= flags & mask;
+
+    if (all && result != mask) {
+        return 0;
+    } else {
+        return result;
+    }
+}
+
+
+/* 
+ * Function        : Wait until any or all of the specified event bits are set.
+ * Parameters      : events  (I) Event flag group to wait on.
+ *                   mask    (I) Event bits to wait for (non-zero).
+ *                   mode    (I) Combination of stdEVENTS_ANY or stdEVENTS_ALL,
+ *                               and optionally stdEVENTS_CLEAR.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : The bits in mask that were found set 
+ *                   (and cleared, when so requested), 
+ *                   or 0 when the wait timed out.
+ */        
+uInt8 stdEventsWait( stdEvents_t events, uInt8 mask, uInt8 mode, uInt16 timeout )
+{
+    uInt8 result;
+
+    stdXDisableInterrupts();
+    {
+        result= eventsMatch(events->flags, mask, mode & stdEVENTS_ALL);
+
+        if (result) {
+            if (mode & stdEVENTS_CLEAR) {
+                events->flags &= ~result;
+            }
+        } else {
+            stdThread_t  self= stdCurrentThread;
+
+            self->waitMask = mask;
+            self->flags    = (self->flags & ~(TF_EVENTS_ALL|TF_EVENTS_CLEAR))
+                           | (mode << TF_EVENTS_SHIFT);
+
+            if (block(&events->waitQ,timeout)) {
+                result= self->waitMask;
+            }
+        }
+    }
+    stdXEnableInterrupts();
+
+    return result;
+}
+
+
+
+/* 
+ * Function        : Set event bits, waking up all threads whose
+ *                   wait condition becomes satisfied.
+ *                   This function may be called from interrupt handlers,
+ *                   either via stdRunISR or between stdISRLock/stdISRUnLock,
+ *                   and does not reenable interrupts.
+ * Parameters      : events  (I) Event flag group to modify.
+ *                   bits    (I) Event bits to set.
+ */        
+void stdEventsSet( stdEvents_t events, uInt8 bits )
+{
+    stdIFlags intenable;
+
+    stdDisableInterrupts(&intenable);
+    {
+        ThreadPrioQ_t *queue   = &events->waitQ;
+        Bool           revived = False;
+
+        events->flags |= bits;
+
+       /*
+        * Wake up waiters in priority order, so that
+        * the most urgent ones get to consume the bits:
+        */
+        while (*queue) {
+            stdThread_t  waiter = *queue;
+            uInt8        match  = eventsMatch( events->flags, waiter->waitMask, 
+                                               (waiter->flags & TF_EVENTS_ALL) != 0 );
+
+            if (match) {
+               *queue            = waiter->next;
+                waiter->waitMask = match;
+
+                if (waiter->flags & TF_EVENTS_CLEAR) {
+                    events->flags &= ~match;
+                }
+
+                wakeUp(waiter);
+                revived= True;
+            } else {
+                queue= &waiter->next;
+            }
+        }
+
+        if (revived) {
+            stdReschedule();   
+        }
+    }
+    stdRestoreInterrupts(intenable);
+}
+
+
+
+/* 
+ * Function        : Clear event bits.
+ * Parameters      : events  (I) Event flag group to modify.
+ *                   bits    (I) Event bits to clear.
+ */        
+void stdEventsClear( stdEvents_t events, uInt8 bits )
+{
+    stdIFlags intenable;
+
+    stdDisableInterrupts(&intenable);
+    events->flags &= ~bits;
+    stdRestoreInterrupts(intenable);
+}
+
+
+
+/* 
+ * Function        : Get currently set event bits, without waiting.
+ * Parameters      : events  (I) Event flag group to inspect.
+ * Function Result : Currently set event bits.
+ */        
+uInt8 stdEventsGet( stdEvents_t events )
+{
+    return events->flags;
+}
+
+/*--------------------------- Multiple Object Waits -------------------------*/
+
+/* 
+ * Function        : Wait until any of a set of semaphores becomes available.
+ *                   Queues can be included by means of stdQueueGetSem. 
+ *                   NB: this function does not acquire the semaphore,
+ *                       so that the object must subsequently be consumed
+ *                       using stdSemTryP or stdQueueTryGet. These only fail
+ *                       when another thread consumed the object in between.
+ *                   NB: threads blocked in stdSemP take precedence over
+ *                       threads waiting via this function.
+ * Parameters      : objects (I) Semaphores to wait on.
+ *                   count   (I) Number of semaphores in objects.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : Index of the first available semaphore in objects,
+ *                   or -1 when the wait timed out.
+ */        
+Int8 stdWaitAny( stdSem_t objects[], uInt8 count, uInt16 timeout )
+{
+    struct stdWatchRec  watches[count];
+    ThreadPrioQ_t       waitQ   = Null;
+    Bool                expired = False;
+    Int8                result  = -1;
+    uInt16              start;
+    uInt8               i;
+
+    stdXDisableInterrupts();
+    {
+        start= kernelTicks;
+
+       /*
+        * Register as watcher of all objects:
+        */
+        for (i= 0; i<count; i++) {
+            watches[i].thread     = stdCurrentThread;
+            watches[i].next       = objects[i]->watchers;
+            objects[i]->watchers  = &watches[i];
+        }
+
+       /*
+        * Wait until an object becomes available. Note that 
+        * after wakeup, another thread may have already consumed
+        * it, in which case we continue waiting for the remaining
+        * time:
+        */
+        while (True) {
+            for (i= 0; i<count; i++) {
+                if (objects[i]->count > 0) { 
+                    result= i; 
+                    break;
+                }
+            }
+
+            if (result >= 0 || expired) {
+                break;
+            }
+
+            if (timeout) {
+                uInt16 elapsed= kernelTicks - start;
+
+                if (elapsed >= timeout) { 
+                    break; 
+                }
+
+                expired= !block(&waitQ, timeout - elapsed);
+            } else {
+                block(&waitQ, stdFOREVER);
+            }
+        }
+
+       /*
+        * Unregister:
+        */
+        for (i= 0; i<count; i++) {
+            struct stdWatchRec **watch= &objects[i]->watchers;
+
+            while (*watch != &watches[i]) {
+                watch= &((*watch)->next);
+            }
+
+           *watch= watches[i].next;
+        }
+    }
+    stdXEnableInterrupts();
+
+    return result;
+}
+
+/*--------------------------- Watchdog Supervision --------------------------*/
+
+   /*
+    * Feed the watchdog when all heartbeats beat 
+    * in time, or else record the first failed one
+    * and let the watchdog bite. Called from the
+    * timer interrupt:
+    */
+    static void checkHeartbeats()
+    {
+        stdHeartbeat_t heartbeat= heartbeats;
+
+        while (heartbeat) {
+            if ( (uInt16)(kernelTicks - heartbeat->lastBeat) > heartbeat->interval ) {
+                if (EEPROM_read(stdWATCHDOG_EEPROM_ADDRESS) != heartbeat->id) {
+                    EEPROM_write(stdWATCHDOG_EEPROM_ADDRESS, heartbeat->id);
+                }
+                watchdogOn= False;
+                return;
+            }
+            heartbeat= heartbeat->next;
+        }
+
+        wdt_reset();
+    }
+
+
+/*
+ * Function        : Register heartbeat with the supervisor, 
+ *                   counting as a first beat.
+ * Parameters      : heartbeat  (I) Heartbeat to register.
+ */        
+void stdHeartbeatAdd( stdHeartbeat_t heartbeat )
+{
+    stdXDisableInterrupts();
+    {
+        heartbeat->lastBeat = kernelTicks;
+        heartbeat->next     = heartbeats;
+        heartbeats          = heartbeat;
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Signal that the thread owning the heartbeat is alive.
+ * Parameters      : heartbeat  (I) Heartbeat to beat.
+ */        
+void stdHeartbeat( stdHeartbeat_t heartbeat )
+{
+    stdXDisableInterrupts();
+    {
+        heartbeat->lastBeat = kernelTicks;
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Enable the watchdog, and start supervision. From then on,
+ *                   the kernel only feeds the watchdog as long as all 
+ *                   registered heartbeats are beating in time. When one fails,
+ *                   its id is recorded in EEPROM, and the watchdog resets the
+ *                   processor. Supervision checks the heartbeats eight times
+ *                   per second, so timeout must be well above that.
+ *                   NB: call stdWatchdogFailure before this function, 
+ *                       which clears the recorded failure.
+ * Parameters      : timeout    (I) Watchdog timeout, as WDTO_xxx value
+ *                                  from <avr/wdt.h>.
+ */        
+void stdWatchdogStart( uInt8 timeout )
+{
+    if (EEPROM_read(stdWATCHDOG_EEPROM_ADDRESS) != stdWATCHDOG_UNKNOWN) {
+        EEPROM_write(stdWATCHDOG_EEPROM_ADDRESS, stdWATCHDOG_UNKNOWN);
+    }
+
+    stdXDisableInterrupts();
+    {
+        wdt_enable(timeout);
+        watchdogOn= True;
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Report why the watchdog reset the processor.
+ * Function Result : 0 when the last reset was not caused by the watchdog,
+ *                   the id of the failed heartbeat, or stdWATCHDOG_UNKNOWN.
+ */        
+uInt8 stdWatchdogFailure()
+{
+    if (resetCause & (1<<WDRF)) {
+        return EEPROM_read(stdWATCHDOG_EEPROM_ADDRESS);
+    } else {
+        return 0;
+    }
+}
+
+
+/*------------------------------- Clock Scaling -----------------------------*/
+
+   /*
+    * Timer2 prescale values, in CS2 order:
+    */
+    static const uInt16 tickPrescales[]= { 1, 8, 32, 64, 128, 256, 1024 };
+
+   /*
+    * Switch the CPU clock to F_CPU / 2^shift, 
+    * reprogramming the kernel ticker when it 
+    * runs from the CPU clock, and notify the 
+    * clock hooks. Returns False, without changing
+    * anything, when the ticker cannot follow:
+    */
+    static Bool setClock( uInt8 shift )
+    {
+        stdClockHook_t hook;
+
+        if (shift == clockShift) {
+            return True;
+        }
+
+      #if defined(THREADS_SYSTEM_TIMER_ASYNC)
+        stdXDisableInterrupts();
+        {
+            CLKPR = (1<<CLKPCE);
+            CLKPR = shift;
+        }
+        stdXEnableInterrupts();
+      #else
+        {
+            uInt32 clock = F_CPU >> shift;
+            uInt16 counts= 0;
+            uInt8  cs;
+
+            for (cs= 0; cs < sizeof(tickPrescales)/sizeof(tickPrescales[0]); cs++) {
+                uInt32 scale= (uInt32)tickPrescales[cs] * stdSECOND;
+
+                counts= (clock + scale/2) / scale;
+
+                if (counts <= 256) { break; }
+            }
+
+            if (counts == 0 || counts > 256) {
+                return False;
+            }
+
+            stdXDisableInterrupts();
+            {
+               /*
+                * Keep the fraction of the current 
+                * tick that has already elapsed:
+                */
+                uInt8 count= (uInt16)TCNT2 * counts / ((uInt16)OCR2A + 1);
+
+                CLKPR  = (1<<CLKPCE);
+                CLKPR  = shift;
+
+                TCCR2B = cs + 1;
+                OCR2A  = counts - 1;
+                TCNT2  = count;
+            }
+            stdXEnableInterrupts();
+        }
+      #endif
+
+        clockShift= shift;
+
+        for (hook= clockHooks; hook; hook= hook->next) {
+            hook->fun( F_CPU >> shift );
+        }
+
+        return True;
+    }
+
+
+/*
+ * Function        : Add a clock hook to the kernel. 
+ *                   Adding a hook that was already added has no effect.
+ * Parameters      : hook       (I) Clock hook to add.
+ */        
+void stdClockHookAdd( stdClockHook_t hook )
+{
+    stdXDisableInterrupts();
+    {
+        stdClockHook_t h= clockHooks;
+
+        while (h && h != hook) {
+            h= h->next;
+        }
+
+        if (!h) {
+            hook->next = clockHooks;
+            clockHooks = hook;
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Set the CPU clock prescaler to be used while no thread
+ *                   requires full speed, and apply it when possible.
+ *                   When Timer2 runs from the CPU clock, the kernel ticker is
+ *                   reprogrammed so that stdSECOND and stdTime remain valid,
+ *                   up to rounding of the timer's compare value.
+ *                   NB: <util/delay.h> delays are computed from F_CPU, 
+ *                       and take longer at reduced clock speed.
+ * Parameters      : shift      (I) Run at F_CPU / 2^shift, 0..8.
+ * Function Result : False iff. the kernel tick rate cannot be
+ *                   obtained at this clock speed.
+ */        
+Bool stdClockSetDivider( uInt8 shift )
+{
+    Bool result= True;
+
+    if (shift > 8) {
+        return False;
+    }
+
+    stdSchedulerLock();
+    {
+        if (clockBoosts == 0) {
+            result= setClock(shift);
+        }
+
+        if (result) {
+            clockDivider= shift;
+        }
+    }
+    stdSchedulerUnlock();
+
+    return result;
+}
+
+
+/*
+ * Function        : Request/release full CPU clock speed for
+ *                   a burst of work. Requests nest, and the divider 
+ *                   set by stdClockSetDivider is restored after 
+ *                   the last release. These functions may only
+ *                   be called by threads.
+ */        
+void stdClockBoost()
+{
+    stdSchedulerLock();
+    {
+        if (clockBoosts++ == 0) {
+            setClock(0);
+        }
+    }
+    stdSchedulerUnlock();
+}
+
+void stdClockRelax()
+{
+    stdSchedulerLock();
+    {
+        if (--clockBoosts == 0) {
+            setClock(clockDivider);
+        }
+    }
+    stdSchedulerUnlock();
+}
+
+
+/*
+ * Function        : Current CPU clock frequency.
+ * Function Result : Frequency in Hz.
+ */        
+uInt32 stdClockFrequency()
+{
+    return F_CPU >> clockShift;
+}
+
+
+/*------------------------------ Object Registry ----------------------------*/
+
+#if defined(THREADS_REGISTRY_ON)
+
+static stdRegistry_t  registry       = Null;
+
+   /*
+    * Hidden import from stdThreads.h, 
+    * only called by constructors before main:
+    */
+    void stdRegistryAdd( stdRegistry_t entry )
+    {
+        Byte   *stack = entry->stack;
+        uInt16  ssize = entry->ssize;
+
+        while (ssize--) {
+           *stack++ = stdSTACK_PAINT;
+        }
+
+        entry->next = registry;
+        registry    = entry;
+    }
+
+
+/*
+ * Function        : Registered objects, most recently registered first.
+ *                   The list is complete when main starts, and 
+ *                   is linked via the next field.
+ * Function Result : First registered object, or Null.
+ */        
+stdRegistry_t stdRegistryList()
+{
+    return registry;
+}
+
+
+/*
+ * Function        : Consistent snapshot of the state of a thread.
+ * Parameters      : thread     (I) Thread to inspect.
+ *                   info       (O) Thread state.
+ */        
+void stdThreadInfo( stdThread_t thread, struct stdThreadInfoRec *info )
+{
+    info->ticks= 0;
+
+    stdXDisableInterrupts();
+    {
+        info->waitQ= thread->waitQ;
+
+        if (thread->flags & TF_TIMED) {
+            stdThread_t timed= timerQ;
+
+            while (timed) {
+                info->ticks += timed->ticks;
+                if (timed == thread) { break; }
+                timed= timed->timerNext;
+            }
+        }
+
+        if (thread == stdCurrentThread) {
+            info->state= stdTHREAD_RUNNING;
+        } else
+        if (thread->flags & TF_EXITED) {
+            info->state= stdTHREAD_EXITED;
+        } else
+        if (thread->waitQ) {
+            info->state= stdTHREAD_WAITING;
+        } else
+        if (thread->flags & TF_TIMED) {
+            info->state= stdTHREAD_SLEEPING;
+        } else
+        if (thread->runCount <= 0) {
+            info->state= stdTHREAD_SUSPENDED;
+        } else {
+            info->state= stdTHREAD_RUNNABLE;
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Consistent snapshot of the timer queue.
+ * Parameters      : threads    (O) Timed threads, earliest first.
+ *                   ticks      (O) Ticks left for each of these threads.
+ *                   max        (I) Size of threads and ticks.
+ * Function Result : Number of threads returned.
+ */        
+uInt8 stdTimerQueueSnapshot( stdThread_t *threads, uInt16 *ticks, uInt8 max )
+{
+    uInt8  result= 0;
+    uInt16 total = 0;
+
+    stdXDisableInterrupts();
+    {
+        stdThread_t timed= timerQ;
+
+        while (timed && result < max) {
+            total           += timed->ticks;
+            threads[result]  = timed;
+            ticks  [result]  = total;
+            result++;
+            timed= timed->timerNext;
+        }
+    }
+    stdXEnableInterrupts();
+
+    return result;
+}
+
+
+/*
+ * Function        : Unused part of a call stack, as far as it
+ *                   still contains its initial stdSTACK_PAINT.
+ * Parameters      : stack      (I) Lowest address of the stack.
+ *                   ssize      (I) Size of stack in bytes.
+ * Function Result : Number of bytes never used.
+ */        
+uInt16 stdStackUnused( Byte *stack, uInt16 ssize )
+{
+    uInt16 result= 0;
+
+    while (result < ssize && stack[result] == stdSTACK_PAINT) {
+        result++;
+    }
+
+    return result;
+}
+
+#endif
+
+
+/*------------------------------ Time Functions -----------------------------*/
+
+   /*
+    * Function        : Timer interrupt handler,
+    *                   must be called at stdSECOND Hz.
     */        
     static void stdTimerHandler()
     {
         stdThread_t qHead;
+        stdTask_t   qTask;
 
         kernelTicks++;
 
+       /*
+        * Supervise heartbeats:
+        */
+        if ( watchdogOn && !(--watchdogCount) ) {
+            watchdogCount= HEARTBEAT_CHECK_PERIOD;
+            checkHeartbeats();
+        }
+
        /*
         * Process queue of sleeping threads:
         */
@@ -329,24 +2160,68 @@ void stdSemV (stdSem_t sem)
             qHead->ticks--;
 
             while (qHead && !qHead->ticks) {
-                DEQUEUE(timerQ);     
-                ENQUEUE(stdRunQ, qHead);
-                qHead->ticks= TIME_SLICE_QUOTA;
+                timerQ        = qHead->timerNext;
+                qHead->flags &= ~TF_TIMED;
+
+               /*
+                * Time out waits:
+                */
+                if (qHead->waitQ) {
+                    unQueue(qHead->waitQ, qHead);
+                    qHead->waitQ  = Null;
+                    qHead->flags |= TF_TIMEDOUT;
+                }
+
+                makeRunnable(qHead);
+                qHead->ticks= QUOTA(qHead);
                 qHead= QUEUEHEAD(timerQ);
             }
         }
 
+       /*
+        * Process queue of task timers:
+        */
+        qTask= taskTimerQ;
+
+        if (qTask) {
+            qTask->ticks--;
+
+            while (qTask && !qTask->ticks) {
+                taskTimerQ    = qTask->timerNext;
+                qTask->flags &= ~TASK_TIMED;
+
+                taskPost(qTask);
+
+                if (qTask->period) {
+                    taskTimerInsert(qTask, qTask->period);
+                }
+
+                qTask= taskTimerQ;
+            }
+        }
+
+    #ifndef THREADS_TIMESLICE_COOPERATIVE
        /*
         * Perform timeslicing if current
-        * thread ran out of quota:
+        * thread ran out of quota. Threads holding
+        * the scheduler lock or running with a raised
+        * preemption threshold are not timesliced:
         */
         qHead= QUEUEHEAD(stdRunQ);
 
-        if ( qHead && !(--qHead->ticks) ) {
-            DEQUEUE(stdRunQ);
-            ENQUEUE(stdRunQ, qHead);
-            qHead->ticks= TIME_SLICE_QUOTA;
+        if ( qHead 
+          && qHead->quota != stdQUOTA_NEVER
+          && !(--qHead->ticks) 
+           ) {
+            if ( !stdSchedNesting 
+              && qHead->threshold <= qHead->priority
+               ) {
+                DEQUEUE(stdRunQ);
+                ENQUEUE(stdRunQ, qHead);
+            }
+            qHead->ticks= QUOTA(qHead);
         }
+    #endif
     }
 
 
@@ -361,32 +2236,14 @@ void stdSemV (stdSem_t sem)
  */        
 void stdThreadSleep (uInt16 delay)
 {
-    stdThread_t  self = stdCurrentThread;
-
     stdXDisableInterrupts(); 
     if (delay) {
-        ThreadPrioQ_t  *queue = &timerQ;
-
        /*
         * Insert current thread into 
         * long range time queue:
         */
-        while ( (*queue) 
-             && (*queue)->ticks <= delay
-              ) { 
-            delay -= (*queue)->ticks;
-            queue= &((*queue)->next); 
-        }
-    
-        if (*queue) {
-            (*queue)->ticks -= delay;
-        }
-
         DEQUEUE(stdRunQ);
-
-        self->ticks = delay;
-        self->next  = *queue;                                             
-       *queue       = self;       
+        timerInsert(stdCurrentThread,delay);
 
         deschedule();   
     }                  
@@ -422,12 +2279,13 @@ uInt16 stdTime()
 
    /*
     * Setup Timer 2 as System Ticker, 
-    *    when cpu and timer driven by a 14745600 Hz external crystal.
-    *    Since system clock freq = 14745600 = 2^^16 * 225, using wraparound 
-    *    of 225 and a clock prescale of 64 gives a 1024 Hz system timer tick. 
+    *    in CTC mode with prescaler and wraparound derived
+    *    from the timer clock and stdSECOND (see stdThreads.h).
+    *    For instance, since 14745600 = 2^^16 * 225, a 14.7456 MHz 
+    *    crystal gives an exact 1024 Hz system timer tick.
     *
-    *    when cpu and timer driven by 8 MHz internal oscillator.
-    *    This configuration allows deep powerdown
+    *    When cpu and timer driven by 8 MHz internal oscillator,
+    *    this configuration allows deep powerdown
     *    when no devices (other than this timer)
     *    are used. Even lower power reduction is achieved
     *    by using an external, 32 kHz crystal
@@ -435,24 +2293,27 @@ uInt16 stdTime()
     */
     SIGNAL(TIMER2_COMPA_vect)
     { 
-       // See remarks in Section 17.9 of ATMega328 data sheet
+       // See remarks in Section 17.9 of ATMega328 data sheet;
+       // waiting for the write to synchronize is left to SLEEP
        #if defined(THREADS_SYSTEM_TIMER_ASYNC)
            TCCR2A = (1<<WGM21);
        #endif
        
        stdRunISR(stdTimerHandler); 
-       
-       // See remarks in Section 17.9 of ATMega328 data sheet
-       #if defined(THREADS_SYSTEM_TIMER_ASYNC)
-           while (ASSR & (1<<TCR2AUB)) {}
-       #endif
     }
 
 
-    #if defined(THREADS_SYSTEM_TIMER_ASYNC) && defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz)
+    #if defined(THREADS_SYSTEM_TIMER_ASYNC) \
+     && ( defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz) \
+       || defined(THREADS_SYSTEM_CLOCK_FREQ_16MHz) \
+       || defined(THREADS_SYSTEM_CLOCK_FREQ_20MHz) \
+        )
         #error  "Impossible crystal combination"
     #endif
 
+    #define TICK_PRESCALE_(prescale)  TIMER2_PRESCALE_##prescale
+    #define TICK_PRESCALE(prescale)   TICK_PRESCALE_(prescale)
+
 
     static void initTimeTicker()
     {
@@ -462,43 +2323,8 @@ uInt16 stdTime()
         ASSR   = (1<<AS2);
        #endif
 
-       #if                                                defined(THREADS_SYSTEM_TIMER_FREQ_32Hz)   &&  defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_1024;
-        OCR2A  = 0;
-       #elif                                              defined(THREADS_SYSTEM_TIMER_FREQ_64Hz)   &&  defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_128;
-        OCR2A  = 3;
-       #elif                                              defined(THREADS_SYSTEM_TIMER_FREQ_128Hz)  &&  defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_128;
-        OCR2A  = 1;
-       #elif                                              defined(THREADS_SYSTEM_TIMER_FREQ_256Hz)  &&  defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_128;
-        OCR2A  = 0;
-       #elif                                              defined(THREADS_SYSTEM_TIMER_FREQ_512Hz)  &&  defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_64;
-        OCR2A  = 0;
-       #elif                                              defined(THREADS_SYSTEM_TIMER_FREQ_1kHz)   &&  defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_1;
-        OCR2A  = 31;
-        
-       #elif  defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz) && defined(THREADS_SYSTEM_TIMER_FREQ_1kHz)   && !defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_64;
-        OCR2A  = 224;
-       #elif  defined(THREADS_SYSTEM_CLOCK_FREQ_32kHz) && defined(THREADS_SYSTEM_TIMER_FREQ_1kHz)   && !defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_1;
-        OCR2A  = 31;
-       #elif  defined(THREADS_SYSTEM_CLOCK_FREQ_32kHz) && defined(THREADS_SYSTEM_TIMER_FREQ_32Hz)   && !defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_1024;
-        OCR2A  = 0;
-       #elif  defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)  && defined(THREADS_SYSTEM_TIMER_FREQ_1kHz)   && !defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_1024;
-        OCR2A  = 7;
-       #elif  defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)  && defined(THREADS_SYSTEM_TIMER_FREQ_32Hz)   && !defined(THREADS_SYSTEM_TIMER_ASYNC)
-        TCCR2B = TIMER2_PRESCALE_1024;
-        OCR2A  = 255;
-       #else
-        #error "unsupported THREADS_SYSTEM_TIMER_FREQ"
-       #endif
+        TCCR2B = TICK_PRESCALE(stdTICK_PRESCALE);
+        OCR2A  = stdTICK_COUNTS(stdTICK_PRESCALE) - 1;
 
         TIMSK2 = (1<<OCIE2A);    // Enable Timer2 Compare Match A interrupts
         TCCR2A = (1<<WGM21);     // CTC mode (clear timer on compare match)
@@ -545,9 +2371,11 @@ void stdSetup()
     
     
    /*
-    * Disable Watchdog:
+    * Disable Watchdog, remembering whether
+    * it caused the reset:
     */
-    MCUSR  &= ~(1<<WDRF);
+    resetCause = MCUSR;
+    MCUSR     &= ~(1<<WDRF);
     WDTCSR |=  (1<<WDCE) | (1<<WDE);
     WDTCSR  =  0x0;
     
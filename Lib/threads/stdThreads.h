@@ -39,6 +39,17 @@ typedef struct stdThreadRec  *stdThread_t;
 typedef struct stdSemRec     *stdSem_t;
 typedef struct stdSemRec     *stdMutex_t;
 typedef struct stdQueueRec   *stdQueue_t;
+typedef struct stdSignalRec  *stdSignal_t;
+typedef struct stdEventsRec  *stdEvents_t;
+typedef struct stdCondRec    *stdCond_t;
+typedef struct stdTaskRec    *stdTask_t;
+typedef struct stdThreadPoolRec  *stdThreadPool_t;
+typedef struct stdIdleHookRec    *stdIdleHook_t;
+typedef struct stdHeartbeatRec   *stdHeartbeat_t;
+typedef struct stdClockHookRec   *stdClockHook_t;
+typedef struct stdRegistryRec    *stdRegistry_t;
+
+typedef struct stdTaskRunnerRec  *stdTaskRunner_t;
 
 typedef stdThread_t           ThreadPrioQ_t;
 
@@ -64,11 +75,97 @@ struct stdThreadRec {
     stdThread_t       next;
     uInt16            ticks;
     stdContext_t      context;
+    stdThread_t       timerNext;    // link in kernel timer queue
+    ThreadPrioQ_t    *waitQ;        // queue in which thread is blocked, or Null
+    uInt8             flags;
+    uInt8             waitMask;     // event flags waited for, or received
+    uInt8             threshold;    // preemption threshold
+    uInt16            deadline;     // absolute deadline, in kernel ticks
+    uInt8             misses;       // deadline miss counter
+    stdPC             entry;        // thread function
+    Pointer           arg;          // argument of thread function
+    ThreadPrioQ_t     joinQ;        // threads waiting for exit
+    uInt8             quota;        // time slice, or stdQUOTA_xxx
+};
+
+struct stdThreadPoolRec {
+    uInt8             size;
+    uInt16            ssize;
+    stdThread_t       threads;
+    Byte             *stacks;
 };
 
 struct stdSemRec {
     Int8              count;
     ThreadPrioQ_t     waitQ;
+    struct stdWatchRec *watchers;   // threads in stdWaitAny
+    stdTask_t         task;         // task posted on release, or Null
+};
+
+/*
+ * Note: a zero initialized signal record
+ *       is a valid, unraised signal:
+ */
+struct stdSignalRec {
+    Bool              raised;
+    ThreadPrioQ_t     waitQ;
+};
+
+struct stdCondRec {
+    ThreadPrioQ_t     waitQ;
+    stdMutex_t        mutex;
+};
+
+struct stdEventsRec {
+    uInt8             flags;
+    ThreadPrioQ_t     waitQ;
+};
+
+    typedef void (*stdTaskFun)( Pointer arg );
+
+struct stdTaskRec {
+    uInt8             priority;
+    uInt8             flags;
+    stdTask_t         next;         // link in runner's ready queue
+    stdTaskRunner_t   runner;
+    stdTaskFun        fun;
+    Pointer           arg;
+    stdTask_t         timerNext;    // link in task timer queue
+    uInt16            ticks;
+    uInt16            period;
+};
+
+/*
+ * A task runner is a thread that executes tasks
+ * on its own stack. The thread must be the first 
+ * field:
+ */
+struct stdTaskRunnerRec {
+    struct stdThreadRec  thread;
+    stdTask_t            readyQ;    // posted tasks, by priority
+    Bool                 busy;      // executing a task
+};
+
+    typedef Bool (*stdIdleFun)();
+
+struct stdIdleHookRec {
+    stdIdleHook_t     next;
+    stdIdleFun        fun;
+    Bool              pending;      // hook has work to do
+};
+
+struct stdHeartbeatRec {
+    stdHeartbeat_t    next;
+    uInt16            interval;     // maximum ticks between beats
+    uInt16            lastBeat;     // kernel time of last beat
+    uInt8             id;           // recorded on failure
+};
+
+    typedef void (*stdClockFun)( uInt32 frequency );
+
+struct stdClockHookRec {
+    stdClockHook_t    next;
+    stdClockFun       fun;
 };
 
 struct stdQueueRec {
@@ -78,6 +175,25 @@ struct stdQueueRec {
     struct stdSemRec  get;
 };
 
+/*
+ * Registration of a statically created kernel object,
+ * see Object Registry below:
+ */
+struct stdRegistryRec {
+    stdRegistry_t     next;
+    uInt8             kind;         // stdOBJ_xxx
+    const char       *name;         // in program memory
+    Pointer           object;
+    Byte             *stack;        // call stack(s), or Null
+    uInt16            ssize;        // total size of stack(s)
+};
+
+struct stdThreadInfoRec {
+    uInt8             state;        // stdTHREAD_xxx
+    uInt16            ticks;        // ticks left when timed, else 0
+    ThreadPrioQ_t    *waitQ;        // queue in which thread is blocked, or Null
+};
+
 
 /*-------------------------------- Constants --------------------------------*/
 
@@ -89,6 +205,20 @@ extern const uInt stdHIGHEST_PRIO;
 #define stdHIGHEST_PRIO         250
 
 
+/*
+ * Timeout value for waiting without 
+ * a time limit:
+ */
+#define stdFOREVER              0
+
+/*
+ * Time slice quota values; other values 
+ * are amounts of kernel clock ticks:
+ */
+#define stdQUOTA_DEFAULT        0
+#define stdQUOTA_NEVER       0xff
+
+
 /*
  * Time constant, amount of ticks of the kernel clock per second.
  */
@@ -108,6 +238,8 @@ extern const uInt stdHIGHEST_PRIO;
     #define stdSECOND    64
 #elif  defined(THREADS_SYSTEM_TIMER_FREQ_128Hz)
     #define stdSECOND   128
+#elif  defined(THREADS_SYSTEM_TIMER_FREQ_256Hz)
+    #define stdSECOND   256
 #elif  defined(THREADS_SYSTEM_TIMER_FREQ_512Hz)
     #define stdSECOND   512
 #elif  defined(THREADS_SYSTEM_TIMER_FREQ_1kHz)
@@ -116,6 +248,74 @@ extern const uInt stdHIGHEST_PRIO;
     #error "unsupported THREADS_SYSTEM_TIMER_FREQ"
 #endif
 
+
+/*
+ * CPU clock frequency in Hz, as also used by <util/delay.h>.
+ * Crystals other than the listed ones can be used by 
+ * defining F_CPU directly:
+ */
+#if   defined(F_CPU)
+#elif defined(THREADS_SYSTEM_CLOCK_FREQ_32kHz)
+    #define F_CPU         32768UL
+#elif defined(THREADS_SYSTEM_CLOCK_FREQ_8MHz)
+    #define F_CPU       8000000UL
+#elif defined(THREADS_SYSTEM_CLOCK_FREQ_14MHz)
+    #define F_CPU      14745600UL
+#elif defined(THREADS_SYSTEM_CLOCK_FREQ_16MHz)
+    #define F_CPU      16000000UL
+#elif defined(THREADS_SYSTEM_CLOCK_FREQ_20MHz)
+    #define F_CPU      20000000UL
+#else
+    #error "unsupported THREADS_SYSTEM_CLOCK_FREQ, define F_CPU instead"
+#endif
+
+
+/*
+ * Kernel clock generation by Timer2, which counts either
+ * the CPU clock, or in ASYNC mode an external 32 kHz crystal.
+ * The smallest prescaler is selected for which the 
+ * amount of timer counts per tick fits in OCR2A, and
+ * the resulting tick rate is given in millionths of stdSECOND.
+ * Deviations of more than 0.1% are warned about:
+ */
+#if defined(THREADS_SYSTEM_TIMER_ASYNC)
+    #define stdTICK_CLOCK       32768UL
+#else
+    #define stdTICK_CLOCK       F_CPU
+#endif
+
+#define stdTICK_COUNTS(prescale)  ((stdTICK_CLOCK + (prescale)*stdSECOND/2) / ((prescale)*stdSECOND))
+
+#if   stdTICK_COUNTS(1) < 1
+    #error "kernel clock too fast for timer clock"
+#elif stdTICK_COUNTS(1)    <= 256
+    #define stdTICK_PRESCALE       1
+#elif stdTICK_COUNTS(8)    <= 256
+    #define stdTICK_PRESCALE       8
+#elif stdTICK_COUNTS(32)   <= 256
+    #define stdTICK_PRESCALE      32
+#elif stdTICK_COUNTS(64)   <= 256
+    #define stdTICK_PRESCALE      64
+#elif stdTICK_COUNTS(128)  <= 256
+    #define stdTICK_PRESCALE     128
+#elif stdTICK_COUNTS(256)  <= 256
+    #define stdTICK_PRESCALE     256
+#elif stdTICK_COUNTS(1024) <= 256
+    #define stdTICK_PRESCALE    1024
+#else
+    #error "kernel clock too slow for timer clock"
+#endif
+
+#define stdTICK_RATE_PPM   ( (1000000ULL * stdTICK_CLOCK) / ((unsigned long long)stdTICK_PRESCALE * stdTICK_COUNTS(stdTICK_PRESCALE) * stdSECOND) )
+#define stdTICK_ERROR_PPM  ( (long)stdTICK_RATE_PPM - 1000000L )
+
+#ifdef stdTICK_PRESCALE
+  #if (1000000ULL * stdTICK_CLOCK) / (stdTICK_PRESCALE * stdTICK_COUNTS(stdTICK_PRESCALE) * stdSECOND) > 1001000 \
+   || (1000000ULL * stdTICK_CLOCK) / (stdTICK_PRESCALE * stdTICK_COUNTS(stdTICK_PRESCALE) * stdSECOND) <  999000
+    #warning "kernel clock deviates more than 0.1% from stdSECOND"
+  #endif
+#endif
+
 /*------------------------------- Module State ------------------------------*/
 
 /*
@@ -153,18 +353,76 @@ Bool stdSleepPrevent( Bool preventSleep );
  * Function        : Macro for statically creating a thread, optionally inserting this into the run queue.
  * Parameters      : name       (I) Name of thread structure variable.
  *                   ssize      (I) Size of call stack in bytes.
- *                   fun        (I) Function to execute (should never terminate).
+ *                   fun        (I) Function to execute. Returning from it exits 
+ *                                  the thread, as by stdThreadExit.
  *                   prio       (I) Thread priority (higher is more urgent).
  *                   runCount   (I) Runnable counter ( 0 suspends the thread).
  *                   prev       (I) Address of previously created thread structure.
  */       
+    /*
+     * Hidden import from stdThreads
+     * for starting threads:
+     */
+    void stdThreadStart();
+
 void  stdInstantiateThread( String name, uInt ssize, Pointer fun, uInt8 prio, uInt8 runCount, stdThread_t prev);
 
 #define stdInstantiateThread(name,ssize,fun,prio,runCount,prev) \
   Byte name##CallStack [ssize ]; \
   struct stdThreadRec name= { prio, runCount, prev, 0, \
-                                 { {0},(uInt16)&name##CallStack[(ssize)-1], (1<<SREG_I), (stdPC)fun } \
-                                }
+                                 { {0},(uInt16)&name##CallStack[(ssize)-1], (1<<SREG_I), stdThreadStart }, \
+                                 .entry= (stdPC)fun \
+                                } \
+  stdRegisterObject(name, stdOBJ_THREAD, &name, name##CallStack, ssize)
+
+/*
+ * Function        : Terminate the current thread, waking up all threads
+ *                   that are joining it. This function does not return.
+ *                   Resuming an exited thread has no effect.
+ */        
+void stdThreadExit();
+
+
+/*
+ * Function        : Wait until a thread has exited.
+ * Parameters      : thread     (I) Thread to wait for.
+ *                   timeout    (I) Maximum amount of kernel clock ticks
+ *                                  to wait, or stdFOREVER.
+ * Function Result : True iff. the thread has exited; False when the wait
+ *                   timed out.
+ */        
+Bool stdThreadJoin( stdThread_t thread, uInt16 timeout );
+
+
+/*
+ * Function        : Macro for statically creating a pool of thread slots,
+ *                   for running short lived jobs on reserved stacks. 
+ * Parameters      : name       (I) Name of pool structure variable.
+ *                   size       (I) Number of thread slots.
+ *                   ssize      (I) Size of call stack of each slot in bytes.
+ */       
+void  stdInstantiateThreadPool( String name, uInt8 size, uInt ssize );
+
+#define stdInstantiateThreadPool(name,size,ssize) \
+  Byte name##CallStacks [(size)*(ssize)]; \
+  struct stdThreadRec name##Threads [size]; \
+  struct stdThreadPoolRec name= { size, ssize, name##Threads, name##CallStacks } \
+  stdRegisterObject(name, stdOBJ_THREAD_POOL, &name, name##CallStacks, (size)*(ssize))
+
+/*
+ * Function        : Start a job in a free slot of a thread pool. A slot is 
+ *                   free when it was never used, or when its previous thread
+ *                   has exited. 
+ *                   NB: a thread that has exited may thus be restarted for
+ *                       another job; joining it is only meaningful while
+ *                       the job's owner controls reuse of the pool.
+ * Parameters      : pool       (I) Pool to start the job in.
+ *                   fun        (I) Function to execute, called with arg.
+ *                   arg        (I) Argument for fun.
+ *                   prio       (I) Thread priority (higher is more urgent).
+ * Function Result : The started thread, or Null when no slot was free.
+ */        
+stdThread_t stdThreadPoolStart( stdThreadPool_t pool, Pointer fun, Pointer arg, uInt8 prio );
 
 /*
  * Function        : Suspend execution of the current thread until a corresponding
@@ -188,6 +446,134 @@ void stdThreadSuspendSelf();
 void stdThreadResume( stdThread_t thread );
 
 
+/*
+ * Function        : Let other runnable threads of the same priority run
+ *                   before continuing the current thread. This is the way
+ *                   for equally urgent threads to share the processor when
+ *                   timeslicing is disabled, either per thread or by 
+ *                   compiling with THREADS_TIMESLICE_COOPERATIVE. 
+ *                   Does nothing while holding the scheduler lock.
+ */        
+void stdThreadYield();
+
+
+/*
+ * Function        : Set time slice quota of a thread: the amount of kernel
+ *                   clock ticks that it may run before other runnable threads
+ *                   of the same priority get their turn. Threads are created
+ *                   with quota stdQUOTA_DEFAULT, which is 4 ticks. The new
+ *                   quota takes effect from the thread's next time slice.
+ *                   When compiled with THREADS_TIMESLICE_COOPERATIVE, 
+ *                   no thread is timesliced, and quotas have no effect.
+ * Parameters      : thread     (I) Thread to set the quota of.
+ *                   quota      (I) Amount of kernel clock ticks, 
+ *                                  stdQUOTA_DEFAULT, or stdQUOTA_NEVER for 
+ *                                  running until blocking or yielding.
+ * Function Result : Old quota.
+ */        
+uInt8 stdThreadSetQuota( stdThread_t thread, uInt8 quota );
+
+
+/*
+ * Function        : Set preemption threshold of the current thread.
+ *                   While running, the current thread can only be preempted
+ *                   by threads with a priority higher than its threshold
+ *                   (or its priority, when that is higher). Threads running
+ *                   with a raised threshold are not timesliced.
+ *                   Threads are created with a threshold of 0.
+ * Parameters      : threshold  (I) New preemption threshold.
+ * Function Result : Old preemption threshold.
+ */        
+uInt8 stdThreadSetThreshold( uInt8 threshold );
+
+
+/*---------------------------- Deadline Scheduling --------------------------*/
+
+/*
+ * Function        : Start a new job of the current thread, which should
+ *                   complete within the specified amount of time. 
+ *                   When compiled with THREADS_SCHEDULING_EDF, threads with
+ *                   a deadline are scheduled earliest deadline first, ahead 
+ *                   of all threads without one. Otherwise, deadlines are 
+ *                   only used for counting deadline misses.
+ *                   Calling this function completes the previous job of the
+ *                   thread, if any, and counts a miss when this happens after
+ *                   the previous job's deadline. Threads that block between
+ *                   jobs should complete each job with stdFOREVER before
+ *                   blocking, since otherwise the time spent blocked counts
+ *                   as part of the job.
+ * Parameters      : deadline   (I) Relative deadline in kernel clock ticks, 
+ *                                  or stdFOREVER for removing the deadline. 
+ */        
+void stdThreadSetDeadline( uInt16 deadline );
+
+
+/*
+ * Function        : Complete the current job of a periodic thread, and wait 
+ *                   for the release of its next job. The next job is released
+ *                   at the current deadline, and gets a deadline one period 
+ *                   later, so that the thread keeps its phase. A miss is 
+ *                   counted when the current job completed after its deadline.
+ *                   The first call on a thread without deadline releases its 
+ *                   next job immediately.
+ * Parameters      : period     (I) Period in kernel clock ticks.
+ */        
+void stdThreadWaitPeriod( uInt16 period );
+
+
+/*
+ * Function        : Get the number of deadline misses of a thread.
+ * Parameters      : thread     (I) Thread to inspect.
+ * Function Result : Number of jobs that completed after their deadline,
+ *                   saturating at 255.
+ */        
+uInt8 stdThreadDeadlineMisses( stdThread_t thread );
+
+
+/*----------------------------- Scheduler Locking ---------------------------*/
+
+/*
+ * Function        : Lock/unlock the scheduler around short non-preemptible 
+ *                   sections in threads. Locks nest. While locked, the current
+ *                   thread is not preempted by other threads, but interrupts 
+ *                   are still served; threads readied by them are scheduled
+ *                   at the outermost unlock.
+ *                   NB: threads must not block (wait, sleep or suspend)
+ *                       while holding the scheduler lock.
+ */
+    /*
+     * Hidden imports from stdThreads
+     * for scheduler locking:
+     */
+    extern volatile uInt8 stdSchedNesting;
+    extern volatile Bool  stdSchedHeldBack;
+    void stdSchedRelease();
+
+   /*
+    * The memory barriers keep the compiler from moving
+    * accesses in the locked section outside of it:
+    */
+void stdSchedulerLock();
+
+#define stdSchedulerLock() \
+{                              \
+    stdSchedNesting++;         \
+    __asm__ __volatile__("" ::: "memory"); \
+}
+
+void stdSchedulerUnlock();
+
+#define stdSchedulerUnlock() \
+{                              \
+    __asm__ __volatile__("" ::: "memory"); \
+    if ( !(--stdSchedNesting)  \
+      &&  stdSchedHeldBack     \
+       ) {                     \
+        stdSchedRelease();     \
+    }                          \
+}
+
+
 /*--------------------------- Semaphore Functions ---------------------------*/
 
 /*
@@ -198,7 +584,8 @@ void stdThreadResume( stdThread_t thread );
 void stdInstantiateSemaphore( String name, uInt8 count );
 
 #define stdInstantiateSemaphore(name,count) \
-  struct stdSemRec name= { count, Null }
+  struct stdSemRec name= { count, Null } \
+  stdRegisterObject(name, stdOBJ_SEMAPHORE, &name, Null, 0)
 
 
 /* 
@@ -270,6 +657,205 @@ void stdMutexExit( stdMutex_t mutex );
 #define stdMutexExit(mutex) stdSemV(mutex)
 
 
+/*---------------------------- Condition Variables --------------------------*/
+
+/*
+ * Condition variables are bound to a mutex, and together 
+ * with it form a monitor: threads enter the mutex, and wait 
+ * on the condition variable until the state protected by the
+ * mutex allows them to proceed. Waiting threads are woken in
+ * priority order. A thread that is woken while the mutex is
+ * held is moved directly to the mutex's wait queue, so that
+ * it is not run before it can actually enter the mutex.
+ */
+
+/*
+ * Function        : Macro for statically creating a condition variable.
+ * Parameters      : name   (I) Name of condition variable structure variable.
+ *                   mutex  (I) Address of mutex to which the condition is bound.
+ */        
+void stdInstantiateCondition( String name, stdMutex_t mutex );
+
+#define stdInstantiateCondition(name,mutex) \
+  struct stdCondRec name= { Null, mutex } \
+  stdRegisterObject(name, stdOBJ_CONDITION, &name, Null, 0)
+
+
+/* 
+ * Function        : Wait on condition variable.
+ *                   Atomically release the condition's mutex 
+ *                   and wait until the condition gets signalled;
+ *                   the mutex is held again when this function returns,
+ *                   also when the wait timed out.
+ *                   The calling thread must hold the mutex.
+ * Parameters      : cond    (I) Condition variable to wait on.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : True iff. the condition was signalled,
+ *                   False when the wait timed out.
+ */        
+Bool stdCondWait( stdCond_t cond, uInt16 timeout );
+
+
+/* 
+ * Function        : Wake up the most urgent thread waiting on condition variable, if any.
+ *                   The calling thread should hold the condition's mutex.
+ * Parameters      : cond (I) Condition variable to signal.
+ */        
+void stdCondSignal( stdCond_t cond );
+
+
+/* 
+ * Function        : Wake up all threads waiting on condition variable.
+ *                   The calling thread should hold the condition's mutex.
+ * Parameters      : cond (I) Condition variable to signal.
+ */        
+void stdCondBroadcast( stdCond_t cond );
+
+
+/*---------------------------------- Signals --------------------------------*/
+
+/*
+ * Signals are binary events, intended for waking up
+ * threads from interrupt handlers. A signal is raised
+ * by an interrupt handler (or thread) and waited for by 
+ * threads. Raising a signal wakes up all threads that
+ * are currently waiting for it; when no thread is waiting,
+ * the signal remains raised so that the next wait returns
+ * immediately. That is, wakeups cannot get lost between
+ * arming a device and starting to wait for it.
+ */
+
+/*
+ * Function        : Macro for statically creating a signal, initially not raised.
+ * Parameters      : name   (I) Name of signal structure variable.
+ */        
+void stdInstantiateSignal( String name );
+
+#define stdInstantiateSignal(name) \
+  struct stdSignalRec name= stdSIGNAL_INITIALIZER \
+  stdRegisterObject(name, stdOBJ_SIGNAL, &name, Null, 0)
+
+
+/*
+ * Function        : Macro for creating a signal, initially not raised,
+ *                   as local variable, for instance for a thread to wait
+ *                   for completion of a request that it passed to a driver.
+ *                   Such signals are not registered.
+ * Parameters      : name   (I) Name of signal structure variable.
+ */        
+void stdInstantiateLocalSignal( String name );
+
+#define stdInstantiateLocalSignal(name) \
+  struct stdSignalRec name= stdSIGNAL_INITIALIZER
+
+#define stdSIGNAL_INITIALIZER   { False, Null }
+
+
+/* 
+ * Function        : Wait until signal is raised, and consume it.
+ * Parameters      : signal  (I) Signal to wait for.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : True iff. the signal was raised, 
+ *                   False when the wait timed out.
+ */        
+Bool stdSignalWait( stdSignal_t signal, uInt16 timeout );
+
+
+/* 
+ * Function        : Raise signal.
+ *                   This function may be called from interrupt handlers,
+ *                   either via stdRunISR or between stdISRLock/stdISRUnLock,
+ *                   and does not reenable interrupts.
+ * Parameters      : signal (I) Signal to raise.
+ */        
+void stdSignalRaise( stdSignal_t signal );
+
+
+/* 
+ * Function        : Clear a pending signal raise.
+ *                   To be used before arming the device that is 
+ *                   going to raise the signal, in case a previous
+ *                   raise might not have been consumed.
+ * Parameters      : signal (I) Signal to reset.
+ */        
+void stdSignalReset( stdSignal_t signal );
+
+
+/*-------------------------------- Event Flags ------------------------------*/
+
+/*
+ * Event flag groups hold 8 independent event bits.
+ * Interrupt handlers (or threads) set bits, and threads
+ * wait until any or all bits in a mask have been set.
+ * This allows a single thread to serve multiple event
+ * sources without polling.
+ */
+
+/*
+ * Wait modes, to be or'ed together:
+ */
+#define stdEVENTS_ANY           0x00    // wait for any bit in mask
+#define stdEVENTS_ALL           0x01    // wait for all bits in mask
+#define stdEVENTS_CLEAR         0x02    // consume the received bits
+
+
+/*
+ * Function        : Macro for statically creating an event flag group.
+ * Parameters      : name   (I) Name of event flag group structure variable.
+ *                   flags  (I) Initially set event bits.
+ */        
+void stdInstantiateEvents( String name, uInt8 flags );
+
+#define stdInstantiateEvents(name,flags) \
+  struct stdEventsRec name= { flags, Null } \
+  stdRegisterObject(name, stdOBJ_EVENTS, &name, Null, 0)
+
+
+/* 
+ * Function        : Wait until any or all of the specified event bits are set.
+ * Parameters      : events  (I) Event flag group to wait on.
+ *                   mask    (I) Event bits to wait for (non-zero).
+ *                   mode    (I) Combination of stdEVENTS_ANY or stdEVENTS_ALL,
+ *                               and optionally stdEVENTS_CLEAR.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : The bits in mask that were found set 
+ *                   (and cleared, when so requested), 
+ *                   or 0 when the wait timed out.
+ */        
+uInt8 stdEventsWait( stdEvents_t events, uInt8 mask, uInt8 mode, uInt16 timeout );
+
+
+/* 
+ * Function        : Set event bits, waking up all threads whose
+ *                   wait condition becomes satisfied.
+ *                   This function may be called from interrupt handlers,
+ *                   either via stdRunISR or between stdISRLock/stdISRUnLock,
+ *                   and does not reenable interrupts.
+ * Parameters      : events  (I) Event flag group to modify.
+ *                   bits    (I) Event bits to set.
+ */        
+void stdEventsSet( stdEvents_t events, uInt8 bits );
+
+
+/* 
+ * Function        : Clear event bits.
+ * Parameters      : events  (I) Event flag group to modify.
+ *                   bits    (I) Event bits to clear.
+ */        
+void stdEventsClear( stdEvents_t events, uInt8 bits );
+
+
+/* 
+ * Function        : Get currently set event bits, without waiting.
+ * Parameters      : events  (I) Event flag group to inspect.
+ * Function Result : Currently set event bits.
+ */        
+uInt8 stdEventsGet( stdEvents_t events );
+
+
 /*------------------------------ Bounded Queues -----------------------------*/
 
 /*
@@ -287,7 +873,8 @@ void stdInstantiateQueue( String name, uInt8 capacity );
         uInt16 contents[capacity];          \
   };\
  struct __##name##__ __##name##__Struct = { { 0,0, (capacity)-1, { capacity, Null }, { 0, Null } } };\
- stdQueue_t name = &__##name##__Struct.queue
+ stdQueue_t name = &__##name##__Struct.queue \
+ stdRegisterObject(name, stdOBJ_QUEUE, &__##name##__Struct.queue, Null, 0)
  
 
 /* 
@@ -336,6 +923,182 @@ void stdQueueGet (stdQueue_t queue, uInt16 *element);
 Bool stdQueueTryGet (stdQueue_t queue, uInt16 *element);
 
 
+/* 
+ * Function        : Semaphore counting the elements in a queue
+ *                   that are available for reading; for passing
+ *                   queues to stdWaitAny.
+ * Parameters      : queue   (I) Queue to get semaphore from.
+ * Function Result : Queue's element count semaphore.
+ */        
+stdSem_t stdQueueGetSem (stdQueue_t queue);
+
+#define stdQueueGetSem(queue) (&(queue)->get)
+
+
+/*--------------------------- Multiple Object Waits -------------------------*/
+
+/* 
+ * Function        : Wait until any of a set of semaphores becomes available.
+ *                   Queues can be included by means of stdQueueGetSem. 
+ *                   This allows a single thread to serve multiple
+ *                   semaphores and queues, as in:
+ *
+ *                       stdSem_t objects[] = { stdQueueGetSem(uartQ), stdQueueGetSem(irQ) };
+ *
+ *                       switch (stdWaitAny(objects,2,stdFOREVER)) {
+ *                       case 0 : if (stdQueueTryGet(uartQ,&cmd)) { ... } break;
+ *                       case 1 : if (stdQueueTryGet(irQ,  &cmd)) { ... } break;
+ *                       }
+ *
+ *                   NB: this function does not acquire the semaphore,
+ *                       so that the object must subsequently be consumed
+ *                       using stdSemTryP or stdQueueTryGet. These only fail
+ *                       when another thread consumed the object in between.
+ *                   NB: threads blocked in stdSemP take precedence over
+ *                       threads waiting via this function.
+ * Parameters      : objects (I) Semaphores to wait on.
+ *                   count   (I) Number of semaphores in objects.
+ *                   timeout (I) Maximum amount of kernel clock ticks
+ *                               to wait, or stdFOREVER.
+ * Function Result : Index of the first available semaphore in objects,
+ *                   or -1 when the wait timed out.
+ */        
+Int8 stdWaitAny( stdSem_t objects[], uInt8 count, uInt16 timeout );
+
+
+/*------------------------- Run-to-completion Tasks -------------------------*/
+
+/*
+ * Function        : Macro for statically creating a task runner: a thread
+ *                   that executes posted tasks on its own stack, one at a time
+ *                   and in priority order. The runner is idle, and takes no 
+ *                   processor time, while no task is posted. While executing 
+ *                   or having posted tasks, the runner competes with other 
+ *                   threads at the priority of its most urgent task.
+ *                   Tasks of the same runner do not preempt each other, so
+ *                   tasks that must be able to do so need separate runners.
+ * Parameters      : name       (I) Name of task runner structure variable.
+ *                   ssize      (I) Size of call stack in bytes, shared by all
+ *                                  tasks of this runner.
+ */       
+    /*
+     * Hidden import from stdThreads
+     * for task runners:
+     */
+    void stdTaskRun();
+
+void  stdInstantiateTaskRunner( String name, uInt ssize );
+
+#define stdInstantiateTaskRunner(name,ssize) \
+  Byte name##CallStack [ssize ]; \
+  struct stdTaskRunnerRec name= { { 0, 1, Null, 0, \
+                                    { {0},(uInt16)&name##CallStack[(ssize)-1], (1<<SREG_I), (stdPC)stdTaskRun } \
+                                  } } \
+  stdRegisterObject(name, stdOBJ_TASK_RUNNER, &name, name##CallStack, ssize)
+
+/*
+ * Function        : Macro for statically creating a run-to-completion task.
+ *                   Each time the task is posted, its function is called once
+ *                   by its runner, and must return without blocking, that is,
+ *                   without waiting, sleeping or suspending. Posts that arrive
+ *                   before the function has started are coalesced.
+ *                   Tasks only need the stack space of their deepest call,
+ *                   on the stack of their runner.
+ * Parameters      : name       (I) Name of task structure variable.
+ *                   fun        (I) Function to execute, called with arg.
+ *                   arg        (I) Argument for fun.
+ *                   prio       (I) Task priority (higher is more urgent).
+ *                   runner     (I) Address of task runner structure.
+ */       
+void  stdInstantiateTask( String name, Pointer fun, Pointer arg, uInt8 prio, stdTaskRunner_t runner );
+
+#define stdInstantiateTask(name,fun,arg,prio,runner) \
+  struct stdTaskRec name= { prio, 0, Null, runner, (stdTaskFun)(fun), (Pointer)(arg) } \
+  stdRegisterObject(name, stdOBJ_TASK, &name, Null, 0)
+
+/*
+ * Function        : Post task for execution by its runner.
+ *                   This function may also be called from interrupt handlers.
+ * Parameters      : task       (I) Task to post.
+ */        
+void stdTaskPost( stdTask_t task );
+
+
+/*
+ * Function        : Post task after a delay, and optionally periodically 
+ *                   thereafter. This replaces a previously started timer.
+ * Parameters      : task       (I) Task to post.
+ *                   delay      (I) Amount of kernel clock ticks until the
+ *                                  first post, or 0 for posting immediately.
+ *                   period     (I) Amount of kernel clock ticks between 
+ *                                  subsequent posts, or 0 for posting once.
+ */        
+void stdTaskStartTimer( stdTask_t task, uInt16 delay, uInt16 period );
+
+
+/*
+ * Function        : Cancel a task's timer, when started. 
+ *                   This does not affect an already posted task.
+ * Parameters      : task       (I) Task to stop posting.
+ */        
+void stdTaskStopTimer( stdTask_t task );
+
+
+/*
+ * Function        : Post task whenever a semaphore is released without
+ *                   waking a thread blocked in stdSemP, that is, whenever 
+ *                   its count is incremented. Queues can be used by means
+ *                   of stdQueueGetSem. The task should then consume the 
+ *                   available elements using stdSemTryP or stdQueueTryGet.
+ *                   The task is posted immediately when the semaphore
+ *                   is already available. A semaphore posts at most one task.
+ * Parameters      : sem        (I) Semaphore to watch.
+ *                   task       (I) Task to post, or Null to stop posting.
+ */        
+void stdSemSetTask( stdSem_t sem, stdTask_t task );
+
+
+/*-------------------------------- Idle Hooks -------------------------------*/
+
+/*
+ * Function        : Macro for statically creating an idle hook: a function 
+ *                   for opportunistic background work, which the kernel calls
+ *                   when no thread is runnable, before deciding to sleep.
+ *                   Each call should perform a bounded amount of work, and
+ *                   return whether more work remains. Pending hooks are called
+ *                   in turn, and are preemptible by any thread made runnable
+ *                   by an interrupt. A hook that reported having no more work
+ *                   is not called again until it is posted. Hooks must not block.
+ *                   NB: hooks run in the kernel's idle context, on a stack of
+ *                       stdIDLE_STACK_SIZE bytes (default 128) that is shared by
+ *                       all hooks. A preempted hook continues as soon as no
+ *                       thread is runnable anymore.
+ * Parameters      : name       (I) Name of idle hook structure variable.
+ *                   fun        (I) Function to call: Bool fun().
+ */       
+void  stdInstantiateIdleHook( String name, Pointer fun );
+
+#define stdInstantiateIdleHook(name,fun) \
+  struct stdIdleHookRec name= { Null, (stdIdleFun)(fun), False }
+
+/*
+ * Function        : Add/remove an idle hook to/from the kernel. 
+ *                   Hooks are added as pending; adding a hook
+ *                   that was already added only marks it pending.
+ * Parameters      : hook       (I) Idle hook to add or remove.
+ */        
+void stdIdleHookAdd   ( stdIdleHook_t hook );
+void stdIdleHookRemove( stdIdleHook_t hook );
+
+
+/*
+ * Function        : Mark idle hook as having work to do.
+ *                   This function may also be called from interrupt handlers.
+ * Parameters      : hook       (I) Idle hook to post.
+ */        
+void stdIdleHookPost( stdIdleHook_t hook );
+
+
 /*------------------------------ Time Functions -----------------------------*/
 
 /*
@@ -357,6 +1120,215 @@ void stdThreadSleep (uInt16 delay);
 uInt16 stdTime();
 
 
+/*--------------------------- Watchdog Supervision --------------------------*/
+
+/*
+ * Result of stdWatchdogFailure when the watchdog
+ * reset the processor without a heartbeat failing,
+ * for instance because interrupts were stalled:
+ */
+#define stdWATCHDOG_UNKNOWN  0xff
+
+/*
+ * Function        : Macro for statically creating a heartbeat, by which a
+ *                   critical thread proves to the watchdog supervisor that
+ *                   it is alive.
+ * Parameters      : name       (I) Name of heartbeat structure variable.
+ *                   interval   (I) Maximum amount of kernel clock ticks 
+ *                                  between beats.
+ *                   id         (I) Identification of the heartbeat, 1..254,
+ *                                  recorded in EEPROM when it fails.
+ */       
+void  stdInstantiateHeartbeat( String name, uInt16 interval, uInt8 id );
+
+#define stdInstantiateHeartbeat(name,interval,id) \
+  struct stdHeartbeatRec name= { Null, interval, 0, id }
+
+/*
+ * Function        : Register heartbeat with the supervisor, 
+ *                   counting as a first beat.
+ * Parameters      : heartbeat  (I) Heartbeat to register.
+ */        
+void stdHeartbeatAdd( stdHeartbeat_t heartbeat );
+
+
+/*
+ * Function        : Signal that the thread owning the heartbeat is alive.
+ * Parameters      : heartbeat  (I) Heartbeat to beat.
+ */        
+void stdHeartbeat( stdHeartbeat_t heartbeat );
+
+
+/*
+ * Function        : Enable the watchdog, and start supervision. From then on,
+ *                   the kernel only feeds the watchdog as long as all 
+ *                   registered heartbeats are beating in time. When one fails,
+ *                   its id is recorded in EEPROM, and the watchdog resets the
+ *                   processor. Supervision checks the heartbeats eight times
+ *                   per second, so timeout must be well above that.
+ *                   NB: call stdWatchdogFailure before this function, 
+ *                       which clears the recorded failure.
+ * Parameters      : timeout    (I) Watchdog timeout, as WDTO_xxx value
+ *                                  from <avr/wdt.h>.
+ */        
+void stdWatchdogStart( uInt8 timeout );
+
+
+/*
+ * Function        : Report why the watchdog reset the processor.
+ * Function Result : 0 when the last reset was not caused by the watchdog,
+ *                   the id of the failed heartbeat, or stdWATCHDOG_UNKNOWN.
+ */        
+uInt8 stdWatchdogFailure();
+
+
+/*------------------------------- Clock Scaling -----------------------------*/
+
+/*
+ * Function        : Macro for statically creating a clock hook: a function 
+ *                   by which a driver reconfigures its device after the 
+ *                   CPU clock frequency changed. Hooks are called by the
+ *                   thread that changed the clock, and must not block.
+ * Parameters      : name       (I) Name of clock hook structure variable.
+ *                   fun        (I) Function to call: void fun(uInt32 frequency).
+ */       
+void  stdInstantiateClockHook( String name, Pointer fun );
+
+#define stdInstantiateClockHook(name,fun) \
+  struct stdClockHookRec name= { Null, (stdClockFun)(fun) }
+
+/*
+ * Function        : Add a clock hook to the kernel. 
+ *                   Adding a hook that was already added has no effect.
+ * Parameters      : hook       (I) Clock hook to add.
+ */        
+void stdClockHookAdd( stdClockHook_t hook );
+
+
+/*
+ * Function        : Set the CPU clock prescaler to be used while no thread
+ *                   requires full speed, and apply it when possible.
+ *                   When Timer2 runs from the CPU clock, the kernel ticker is
+ *                   reprogrammed so that stdSECOND and stdTime remain valid,
+ *                   up to rounding of the timer's compare value.
+ *                   NB: <util/delay.h> delays are computed from F_CPU, 
+ *                       and take longer at reduced clock speed.
+ * Parameters      : shift      (I) Run at F_CPU / 2^shift, 0..8.
+ * Function Result : False iff. the kernel tick rate cannot be
+ *                   obtained at this clock speed.
+ */        
+Bool stdClockSetDivider( uInt8 shift );
+
+
+/*
+ * Function        : Request/release full CPU clock speed for
+ *                   a burst of work. Requests nest, and the divider 
+ *                   set by stdClockSetDivider is restored after 
+ *                   the last release. These functions may only
+ *                   be called by threads.
+ */        
+void stdClockBoost();
+void stdClockRelax();
+
+
+/*
+ * Function        : Current CPU clock frequency.
+ * Function Result : Frequency in Hz.
+ */        
+uInt32 stdClockFrequency();
+
+
+/*------------------------------ Object Registry ----------------------------*/
+
+/*
+ * When compiled with THREADS_REGISTRY_ON, the stdInstantiate
+ * macros register the objects that they create, by name, 
+ * so that they can be inspected at runtime (see stdShell.h).
+ * Call stacks of registered threads are filled with 
+ * stdSTACK_PAINT, for measuring their high-water marks.
+ * Without THREADS_REGISTRY_ON, none of this costs anything.
+ */
+#define stdOBJ_THREAD            1
+#define stdOBJ_THREAD_POOL       2
+#define stdOBJ_TASK_RUNNER       3
+#define stdOBJ_TASK              4
+#define stdOBJ_SEMAPHORE         5
+#define stdOBJ_CONDITION         6
+#define stdOBJ_SIGNAL            7
+#define stdOBJ_EVENTS            8
+#define stdOBJ_QUEUE             9
+
+#define stdSTACK_PAINT        0xa5
+
+/*
+ * Thread states reported by stdThreadInfo:
+ */
+#define stdTHREAD_RUNNING        0
+#define stdTHREAD_RUNNABLE       1
+#define stdTHREAD_WAITING        2    // in waitQ, possibly with timeout
+#define stdTHREAD_SLEEPING       3
+#define stdTHREAD_SUSPENDED      4
+#define stdTHREAD_EXITED         5
+
+#if defined(THREADS_REGISTRY_ON)
+
+    #include <avr/pgmspace.h>
+
+    /*
+     * Hidden import from stdThreads
+     * for registering objects, called 
+     * before main by a constructor per object:
+     */
+    void stdRegistryAdd( stdRegistry_t entry );
+
+    #define stdRegisterObject(name,kind,object,stack,ssize) \
+      ; static struct stdRegistryRec name##Registration; \
+        static void name##Register() __attribute__((constructor)); \
+        static void name##Register() { stdRegistryAdd(&name##Registration); } \
+        static const char name##RegisteredName[] PROGMEM = #name; \
+        static struct stdRegistryRec name##Registration= { Null, kind, name##RegisteredName, (Pointer)(object), (Byte*)(stack), ssize }
+
+/*
+ * Function        : Registered objects, most recently registered first.
+ *                   The list is complete when main starts, and 
+ *                   is linked via the next field.
+ * Function Result : First registered object, or Null.
+ */        
+stdRegistry_t stdRegistryList();
+
+
+/*
+ * Function        : Consistent snapshot of the state of a thread.
+ * Parameters      : thread     (I) Thread to inspect.
+ *                   info       (O) Thread state.
+ */        
+void stdThreadInfo( stdThread_t thread, struct stdThreadInfoRec *info );
+
+
+/*
+ * Function        : Consistent snapshot of the timer queue.
+ * Parameters      : threads    (O) Timed threads, earliest first.
+ *                   ticks      (O) Ticks left for each of these threads.
+ *                   max        (I) Size of threads and ticks.
+ * Function Result : Number of threads returned.
+ */        
+uInt8 stdTimerQueueSnapshot( stdThread_t *threads, uInt16 *ticks, uInt8 max );
+
+
+/*
+ * Function        : Unused part of a call stack, as far as it
+ *                   still contains its initial stdSTACK_PAINT.
+ * Parameters      : stack      (I) Lowest address of the stack.
+ *                   ssize      (I) Size of stack in bytes.
+ * Function Result : Number of bytes never used.
+ */        
+uInt16 stdStackUnused( Byte *stack, uInt16 ssize );
+
+#else
+    #define stdRegisterObject(name,kind,object,stack,ssize)
+#endif
+
+
 /*-------------------------- Kernel Initialization --------------------------*/
 
 /*
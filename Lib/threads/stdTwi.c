@@ -0,0 +1,446 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements the TWI master and slave driver.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include <avr/io.h>
+
+#include "stdThreads.h"
+#include "stdTwi.h"
+
+/*------------------------------- Module State ------------------------------*/
+
+/*
+ * TWCR value that continues the bus operation
+ * after handling an interrupt:
+ */
+#define TWCR_GO    ((1<<TWEN) | (1<<TWIE) | (1<<TWINT))
+
+static uInt32               bitRate;
+
+/*
+ * Submitted transactions; the head of
+ * the queue is the one on the bus:
+ */
+static stdTwiTransaction_t  queueHead;
+static stdTwiTransaction_t  queueTail;
+
+/*
+ * Progress of the head transaction:
+ */
+static const uInt8         *txNext;
+static uInt8               *rxNext;
+static uInt8                txLeft;
+static uInt8                rxLeft;
+static Bool                 reading;
+
+/*
+ * Slave buffers, and progress of the
+ * current slave transfer, if any; twcrAck
+ * is (1<<TWEA) when slave mode is enabled:
+ */
+static uInt8                twcrAck;
+static Bool                 slaveBusy;
+static uInt8               *slaveRx;
+static uInt8                slaveRxSize;
+static uInt8                slaveRxFill;
+static uInt8                slaveRxCount;
+static const uInt8         *slaveTx;
+static uInt8                slaveTxSize;
+static uInt8                slaveTxNext;
+static stdSignal_t          slaveReceived;
+
+/*
+ * Signal to raise from the interrupt handler:
+ */
+static stdSignal_t          raised;
+
+/*-------------------------------- Bit Rate ---------------------------------*/
+
+   /*
+    * SCL frequency is cpu clock / (16 + 2*TWBR*4^TWPS);
+    * choose the smallest prescaler that allows the
+    * fastest rate that does not exceed bitRate:
+    */
+    static void setBitRate( uInt32 clock )
+    {
+        uInt32 twbr= 0;
+        uInt8  twps= 0;
+
+        if (clock > 16*bitRate) {
+            twbr= ( (clock + bitRate - 1) / bitRate - 16 + 1 ) / 2;
+        }
+
+        while (twbr > 255 && twps < 3) {
+            twbr= (twbr + 3) / 4;
+            twps++;
+        }
+
+        if (twbr > 255) { twbr= 255; }
+
+        TWBR = twbr;
+        TWSR = twps;
+    }
+
+    static stdInstantiateClockHook( twiClock, setBitRate );
+
+/*---------------------------- Interrupt Handler ----------------------------*/
+
+    static void raiseHandler()
+    {
+        stdSignalRaise(raised);
+    }
+
+   /*
+    * Raise signal from the interrupt handler;
+    * must be its last action:
+    */
+    static inline void raiseFromISR( stdSignal_t signal )
+    {
+        if (signal) {
+            raised= signal;
+            stdRunISR(raiseHandler);
+        }
+    }
+
+   /*
+    * (Re)start the head transaction from its beginning:
+    */
+    static void begin()
+    {
+        stdTwiTransaction_t transaction= queueHead;
+
+        txNext = transaction->tx;
+        txLeft = transaction->txSize;
+        rxNext = transaction->rx;
+        rxLeft = transaction->rxSize;
+        reading= !txLeft && rxLeft;
+    }
+
+   /*
+    * Continuation that acknowledges the next byte received
+    * as master when more than that byte are expected:
+    */
+    static inline uInt8 masterAck()
+    {
+        return rxLeft > 1 ? (1<<TWEA) : 0;
+    }
+
+   /*
+    * Continuation after a slave transfer has ended,
+    * which starts the next master transaction
+    * as soon as the bus is free:
+    */
+    static inline uInt8 slaveDone()
+    {
+        slaveBusy= False;
+
+        return TWCR_GO | twcrAck | (queueHead ? (1<<TWSTA) : 0);
+    }
+
+   /*
+    * Finish the head transaction with a stop,
+    * and start the next one, if any:
+    */
+    static void complete( uInt8 status )
+    {
+        stdTwiTransaction_t transaction= queueHead;
+
+        queueHead= transaction->next;
+
+        if (queueHead) {
+            begin();
+            TWCR = TWCR_GO | twcrAck | (1<<TWSTO) | (1<<TWSTA);
+        } else {
+            queueTail= Null;
+            TWCR = TWCR_GO | twcrAck | (1<<TWSTO);
+        }
+
+        transaction->status= status;
+
+        raiseFromISR(transaction->done);
+    }
+
+    SIGNAL(TWI_vect)
+    {
+        switch (TWSR & 0xf8) {
+       /*
+        * Master:
+        */
+        case 0x08 : // START transmitted
+        case 0x10 : // repeated START transmitted
+            TWDR = (queueHead->address << 1) | (reading ? 1 : 0);
+            TWCR = TWCR_GO | twcrAck;
+            break;
+
+        case 0x38 : // arbitration lost; retry when the bus is free
+            begin();
+            TWCR = TWCR_GO | twcrAck | (1<<TWSTA);
+            break;
+
+        case 0x18 : // SLA+W transmitted, ACK received
+        case 0x28 : // data byte transmitted, ACK received
+            if (txLeft) {
+                txLeft--;
+                TWDR = *txNext++;
+                TWCR = TWCR_GO | twcrAck;
+            } else
+            if (rxLeft) {
+                reading= True;
+                TWCR   = TWCR_GO | twcrAck | (1<<TWSTA);
+            } else {
+                complete(stdTWI_OK);
+            }
+            break;
+
+        case 0x20 : // SLA+W transmitted, NACK received
+        case 0x48 : // SLA+R transmitted, NACK received
+            complete(stdTWI_NACK_ADDRESS);
+            break;
+
+        case 0x30 : // data byte transmitted, NACK received
+            complete(stdTWI_NACK_DATA);
+            break;
+
+        case 0x40 : // SLA+R transmitted, ACK received
+            TWCR = TWCR_GO | masterAck();
+            break;
+
+        case 0x50 : // data byte received, ACK returned
+            rxLeft--;
+           *rxNext++ = TWDR;
+            TWCR = TWCR_GO | masterAck();
+            break;
+
+        case 0x58 : // last data byte received, NACK returned
+           *rxNext = TWDR;
+            complete(stdTWI_OK);
+            break;
+
+       /*
+        * Slave receiver:
+        */
+        case 0x68 : // arbitration lost as master, own SLA+W received
+            begin();
+            /* fall through */
+
+        case 0x60 : // own SLA+W received
+            slaveBusy  = True;
+            slaveRxFill= 0;
+            TWCR = TWCR_GO | (slaveRxSize ? (1<<TWEA) : 0);
+            break;
+
+        case 0x80 : // data byte received, ACK returned
+            slaveRx[slaveRxFill++]= TWDR;
+            TWCR = TWCR_GO | (slaveRxFill < slaveRxSize ? (1<<TWEA) : 0);
+            break;
+
+        case 0x88 : // data byte received, NACK returned; message ends here
+        case 0xa0 : // STOP or repeated START received
+            TWCR = slaveDone();
+            slaveRxCount= slaveRxFill;
+            raiseFromISR(slaveReceived);
+            break;
+
+       /*
+        * Slave transmitter:
+        */
+        case 0xb0 : // arbitration lost as master, own SLA+R received
+            begin();
+            /* fall through */
+
+        case 0xa8 : // own SLA+R received
+            slaveBusy  = True;
+            slaveTxNext= 0;
+            /* fall through */
+
+        case 0xb8 : // data byte transmitted, ACK received
+            if (slaveTxNext < slaveTxSize) {
+                TWDR = slaveTx[slaveTxNext++];
+            } else {
+                TWDR = 0xff;
+            }
+            TWCR = TWCR_GO | (1<<TWEA);
+            break;
+
+        case 0xc0 : // data byte transmitted, NACK received
+        case 0xc8 : // last data byte transmitted, ACK received
+            TWCR = slaveDone();
+            break;
+
+       /*
+        * Illegal start or stop condition:
+        */
+        case 0x00 :
+            slaveBusy= False;
+
+            if (queueHead) {
+                complete(stdTWI_BUS_ERROR);
+            } else {
+                TWCR = TWCR_GO | twcrAck | (1<<TWSTO);
+            }
+            break;
+
+        default   :
+            TWCR = TWCR_GO | twcrAck;
+            break;
+        }
+    }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Power up the TWI, as master only.
+ * Parameters      : frequency  (I) Maximal SCL frequency in Hz,
+ *                                  normally stdTWI_100kHz or stdTWI_400kHz.
+ */
+void stdTwiInit( uInt32 frequency )
+{
+    PRR &= ~(1<<PRTWI);
+
+    queueHead= Null;
+    queueTail= Null;
+    twcrAck  = 0;
+    slaveBusy= False;
+
+    bitRate  = frequency;
+    setBitRate( stdClockFrequency() );
+    stdClockHookAdd(&twiClock);
+
+    TWCR = (1<<TWEN) | (1<<TWIE);
+}
+
+
+/*
+ * Function        : Queue a transaction, and return without waiting for it.
+ *                   Transactions are performed in the order of submission.
+ * Parameters      : transaction (I) Transaction to perform.
+ */
+void stdTwiSubmit( stdTwiTransaction_t transaction )
+{
+    transaction->next  = Null;
+    transaction->status= stdTWI_PENDING;
+
+    stdXDisableInterrupts();
+    {
+        if (queueHead) {
+            queueTail->next= transaction;
+            queueTail      = transaction;
+        } else {
+            queueHead= transaction;
+            queueTail= transaction;
+            begin();
+
+           /*
+            * When a slave transfer is in progress or about to be
+            * handled, the start is issued when it has ended:
+            */
+            if (!slaveBusy && !(TWCR & (1<<TWINT))) {
+                TWCR = TWCR_GO | twcrAck | (1<<TWSTA);
+            }
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Perform a transaction, blocking the calling
+ *                   thread until it is complete.
+ * Parameters      : address    (I) 7-bit slave address.
+ *                   tx         (I) Bytes to write.
+ *                   txSize     (I) Number of bytes to write.
+ *                   rx         (O) Buffer for the bytes read.
+ *                   rxSize     (I) Number of bytes to read.
+ * Function Result : Status of the transaction.
+ */
+uInt8 stdTwiTransfer( uInt8 address, const uInt8 *tx, uInt8 txSize, uInt8 *rx, uInt8 rxSize )
+{
+    stdInstantiateLocalSignal( done );
+    struct stdTwiTransactionRec  transaction;
+
+    transaction.address= address;
+    transaction.tx     = tx;
+    transaction.txSize = txSize;
+    transaction.rx     = rx;
+    transaction.rxSize = rxSize;
+    transaction.done   = &done;
+
+    stdTwiSubmit(&transaction);
+    stdSignalWait(&done, stdFOREVER);
+
+    return transaction.status;
+}
+
+
+/*
+ * Function        : Also respond as slave at an address. Messages that are
+ *                   written to this address are stored in rx, which is
+ *                   overwritten by each following message; bytes that do not
+ *                   fit are refused. Reads from this address are answered
+ *                   with the contents of tx, followed by 0xff bytes.
+ * Parameters      : address    (I) Own 7-bit slave address.
+ *                   rx         (I) Buffer for received messages.
+ *                   rxSize     (I) Size of rx.
+ *                   tx         (I) Reply contents.
+ *                   txSize     (I) Size of tx.
+ *                   received   (I) Signal raised after each received
+ *                                  message, or Null.
+ */
+void stdTwiSlave( uInt8 address, uInt8 *rx, uInt8 rxSize, const uInt8 *tx, uInt8 txSize, stdSignal_t received )
+{
+    stdXDisableInterrupts();
+    {
+        slaveRx      = rx;
+        slaveRxSize  = rxSize;
+        slaveRxCount = 0;
+        slaveTx      = tx;
+        slaveTxSize  = txSize;
+        slaveReceived= received;
+
+        TWAR    = address << 1;
+        twcrAck = (1<<TWEA);
+
+        if (!queueHead && !slaveBusy && !(TWCR & (1<<TWINT))) {
+            TWCR = (1<<TWEN) | (1<<TWIE) | (1<<TWEA);
+        }
+    }
+    stdXEnableInterrupts();
+}
+
+
+/*
+ * Function        : Number of bytes in the last
+ *                   message received as slave.
+ */
+uInt8 stdTwiSlaveReceived()
+{
+    return slaveRxCount;
+}
+
+
+/*
+ * Function        : Power down the TWI. No transactions
+ *                   should be queued anymore.
+ */
+void stdTwiTerm()
+{
+    TWCR = 0;
+    PRR |= (1<<PRTWI);
+}
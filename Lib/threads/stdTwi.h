@@ -0,0 +1,141 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides an interrupt driven TWI (I2C) driver. As master,
+ *         it performs queued transactions, each of which writes a number of
+ *         bytes to a slave, then reads a number of bytes from it after a
+ *         repeated start, all without involving threads until the transaction
+ *         has completed. As slave, it receives messages from other masters
+ *         into a buffer, and replies to reads from a second buffer.
+ *
+ *         Pins: SDA is PC4, SCL is PC5; both need external pull-up resistors.
+ */
+
+#ifndef stdTwi_INCLUDED
+#define stdTwi_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include "stdTypes.h"
+#include "stdThreads.h"
+
+/*---------------------------------- Types ----------------------------------*/
+
+/*
+ * Standard bus frequencies:
+ */
+#define stdTWI_100kHz       100000UL
+#define stdTWI_400kHz       400000UL
+
+/*
+ * Transaction status:
+ */
+#define stdTWI_OK             0
+#define stdTWI_PENDING        1
+#define stdTWI_NACK_ADDRESS   2   /* no slave acknowledged the address  */
+#define stdTWI_NACK_DATA      3   /* the slave refused a written byte   */
+#define stdTWI_BUS_ERROR      4
+
+/*
+ * Transaction with the slave at (7-bit) address: txSize bytes
+ * from tx are written, and then, after a repeated start, rxSize
+ * bytes are read into rx. Either part may be empty; when both
+ * are, only the address is sent, which probes for the presence
+ * of the slave. The done signal, when not Null, is raised when
+ * status is no longer stdTWI_PENDING. A transaction is owned by
+ * the driver from the moment that it is submitted until then:
+ */
+typedef struct stdTwiTransactionRec *stdTwiTransaction_t;
+
+struct stdTwiTransactionRec {
+    stdTwiTransaction_t  next;
+    uInt8                address;
+    const uInt8         *tx;
+    uInt8                txSize;
+    uInt8               *rx;
+    uInt8                rxSize;
+    stdSignal_t          done;
+    volatile uInt8       status;
+};
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Power up the TWI, as master only.
+ * Parameters      : frequency  (I) Maximal SCL frequency in Hz,
+ *                                  normally stdTWI_100kHz or stdTWI_400kHz.
+ */
+void stdTwiInit( uInt32 frequency );
+
+
+/*
+ * Function        : Queue a transaction, and return without waiting for it.
+ *                   Transactions are performed in the order of submission.
+ * Parameters      : transaction (I) Transaction to perform.
+ */
+void stdTwiSubmit( stdTwiTransaction_t transaction );
+
+
+/*
+ * Function        : Perform a transaction, blocking the calling
+ *                   thread until it is complete.
+ * Parameters      : address    (I) 7-bit slave address.
+ *                   tx         (I) Bytes to write.
+ *                   txSize     (I) Number of bytes to write.
+ *                   rx         (O) Buffer for the bytes read.
+ *                   rxSize     (I) Number of bytes to read.
+ * Function Result : Status of the transaction.
+ */
+uInt8 stdTwiTransfer( uInt8 address, const uInt8 *tx, uInt8 txSize, uInt8 *rx, uInt8 rxSize );
+
+uInt8 stdTwiWrite( uInt8 address, const uInt8 *tx, uInt8 txSize );
+uInt8 stdTwiRead ( uInt8 address, uInt8 *rx, uInt8 rxSize );
+
+#define stdTwiWrite(address,tx,txSize)   stdTwiTransfer(address,tx,txSize,Null,0)
+#define stdTwiRead(address,rx,rxSize)    stdTwiTransfer(address,Null,0,rx,rxSize)
+
+
+/*
+ * Function        : Also respond as slave at an address. Messages that are
+ *                   written to this address are stored in rx, which is
+ *                   overwritten by each following message; bytes that do not
+ *                   fit are refused. Reads from this address are answered
+ *                   with the contents of tx, followed by 0xff bytes.
+ * Parameters      : address    (I) Own 7-bit slave address.
+ *                   rx         (I) Buffer for received messages.
+ *                   rxSize     (I) Size of rx.
+ *                   tx         (I) Reply contents.
+ *                   txSize     (I) Size of tx.
+ *                   received   (I) Signal raised after each received
+ *                                  message, or Null.
+ */
+void stdTwiSlave( uInt8 address, uInt8 *rx, uInt8 rxSize, const uInt8 *tx, uInt8 txSize, stdSignal_t received );
+
+
+/*
+ * Function        : Number of bytes in the last
+ *                   message received as slave.
+ */
+uInt8 stdTwiSlaveReceived();
+
+
+/*
+ * Function        : Power down the TWI. No transactions
+ *                   should be queued anymore.
+ */
+void stdTwiTerm();
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This module implements SPI transfers via USART0 in Master SPI Mode.
+ */
+
+/*--------------------------------- Includes --------------------------------*/
+
+#include "stdThreads.h"
+#include "stdUSpi.h"
+
+/*------------------------------- Module State ------------------------------*/
+
+#define XCK_PIN   (1<<PD4)
+#define TXD_PIN   (1<<PD1)
+
+/*
+ * Transfers that take at most this number of cpu
+ * cycles are busy waited, since blocking and being
+ * woken up by the interrupt handler costs more:
+ */
+#define POLL_CYCLES   256
+
+static stdInstantiateMutex ( busLock );
+static stdInstantiateSignal( transferDone );
+
+/*
+ * Transfer in progress, advanced
+ * by the receive interrupt:
+ */
+static const uInt8   * volatile txNext;
+static uInt8         * volatile rxNext;
+static volatile uInt16            txLeft;
+static volatile uInt16            rxLeft;
+
+/*------------------------------ Interrupt Handler --------------------------*/
+
+    static void transferHandler()
+    {
+        stdSignalRaise(&transferDone);
+    }
+
+   /*
+    * Send the next byte of the transfer:
+    */
+    static inline void sendNext()
+    {
+        txLeft--;
+        UDR0= txNext ? *txNext++ : 0xff;
+    }
+
+   /*
+    * Each received byte makes room in the transmit
+    * buffer, which is then refilled immediately, so
+    * that the transmitter does not run dry:
+    */
+    SIGNAL(USART_RX_vect)
+    {
+        uInt8 x= UDR0;
+
+        if (txLeft) { sendNext(); }
+        if (rxNext) { *rxNext++ = x; }
+
+        if (--rxLeft == 0) {
+            UCSR0B &= ~(1<<RXCIE0);
+            stdRunISR(transferHandler);
+        }
+    }
+
+/*----------------------------- Device Selection ----------------------------*/
+
+   /*
+    * Baud register value for the highest SCK frequency
+    * that does not exceed that of device, which is
+    * cpu clock / (2*(UBRR0+1)):
+    */
+    static uInt16 deviceUbrr( stdUSpiDevice_t device )
+    {
+        if (stdBusClockChanged(&device->bus)) {
+            uInt32 divisor= 2*device->bus.frequency;
+            uInt32 ubrr   = (device->bus.clock + divisor - 1) / divisor;
+
+            if (ubrr > 0)    { ubrr--;     }
+            if (ubrr > 4095) { ubrr= 4095; }
+
+            device->ubrr= ubrr;
+        }
+
+        return device->ubrr;
+    }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Power up USART0 in Master SPI Mode.
+ */
+void stdUSpiInit()
+{
+   /*
+    * Power up the usart, and make XCK an output before
+    * selecting MSPIM mode, as required by the datasheet:
+    */
+    PRR   &= ~(1<<PRUSART0);
+
+    UBRR0  = 0;
+    DDRD  |= XCK_PIN | TXD_PIN;
+    UCSR0C = (1<<UMSEL01) | (1<<UMSEL00);
+    UCSR0B = (1<<RXEN0)   | (1<<TXEN0);
+}
+
+
+/*
+ * Function        : Exchange bytes with a device, with the device
+ *                   selected during the whole transfer. The calling
+ *                   thread blocks until the transfer is complete,
+ *                   unless it is so short that waiting for it is
+ *                   cheaper than a context switch.
+ * Parameters      : device     (I) Device to exchange with.
+ *                   tx         (I) Bytes to send, or Null for sending 0xff.
+ *                   rx         (O) Received bytes, or Null for discarding them.
+ *                   size       (I) Number of bytes.
+ */
+void stdUSpiTransfer( stdUSpiDevice_t device, const uInt8 *tx, uInt8 *rx, uInt16 size )
+{
+    uInt16 ubrr;
+
+    if (!size) { return; }
+
+    stdMutexEnter(&busLock);
+
+    ubrr= deviceUbrr(device);
+
+    UCSR0C = (1<<UMSEL01) | (1<<UMSEL00) | device->bus.mode;
+    UBRR0  = ubrr;
+
+    stdBusSelect(&device->bus);
+
+    while (UCSR0A & (1<<RXC0)) { (void)UDR0; }
+
+    txNext= tx;
+    rxNext= rx;
+    txLeft= size;
+    rxLeft= size;
+
+    if ((uInt32)size * 16 * (ubrr+1) <= POLL_CYCLES) {
+       /*
+        * Short transfer:
+        */
+        while (rxLeft) {
+            sendNext();
+
+            while (!(UCSR0A & (1<<RXC0))) {}
+
+            if (rxNext) { *rxNext++ = UDR0; }
+                   else { (void)UDR0;       }
+            rxLeft--;
+        }
+    } else {
+       /*
+        * Fill both transmit buffer levels,
+        * and let the interrupt handler do the rest:
+        */
+        stdSignalReset(&transferDone);
+
+        sendNext();
+
+        if (txLeft) {
+            while (!(UCSR0A & (1<<UDRE0))) {}
+            sendNext();
+        }
+
+        UCSR0B |= (1<<RXCIE0);
+
+        stdSignalWait(&transferDone, stdFOREVER);
+    }
+
+    stdBusDeselect(&device->bus);
+
+    stdMutexExit(&busLock);
+}
+
+
+/*
+ * Function        : Power down USART0.
+ */
+void stdUSpiTerm()
+{
+    UCSR0B = 0;
+    PRR   |= (1<<PRUSART0);
+}
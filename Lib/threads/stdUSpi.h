@@ -0,0 +1,114 @@
+/*
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *         This API provides a second SPI master channel by running USART0
+ *         in Master SPI Mode (MSPIM), with interrupt driven transfers that
+ *         keep both transmit buffer levels filled, so that SCK can run at
+ *         up to half the cpu clock without gaps between bytes.
+ *
+ *         Pins: MOSI is TXD (PD1), MISO is RXD (PD0), SCK is XCK (PD4).
+ *         Since USART0 is used, this cannot be combined with the uart
+ *         functions in uart.h (linking both gives duplicate vectors).
+ *
+ *         Each device has its own chip select pin, SPI mode, bit order
+ *         and maximum clock frequency, which are set up for every transfer.
+ *         Threads that transfer at the same time are served in turn.
+ */
+
+#ifndef stdUSpi_INCLUDED
+#define stdUSpi_INCLUDED
+
+/*-------------------------------- Includes ---------------------------------*/
+
+#include <avr/io.h>
+#include "stdTypes.h"
+#include "stdBusDevice.h"
+
+/*---------------------------------- Types ----------------------------------*/
+
+/*
+ * SPI modes (clock polarity and phase)
+ * and bit order, as UCSR0C bits:
+ */
+#define stdUSPI_MODE0       0
+#define stdUSPI_MODE1       (1<<UCPHA0)
+#define stdUSPI_MODE2       (1<<UCPOL0)
+#define stdUSPI_MODE3       ((1<<UCPOL0)|(1<<UCPHA0))
+#define stdUSPI_LSB_FIRST   (1<<UDORD0)
+
+/*
+ * Device on the MSPIM bus, see stdBusDevice.h:
+ */
+typedef struct stdUSpiDeviceRec {
+    struct stdBusDeviceRec  bus;
+
+   /* private: */
+    uInt16                  ubrr;
+} *stdUSpiDevice_t;
+
+/*
+ * Function        : Define a device.
+ * Parameters      : name       (I) Name of the device.
+ *                   port       (I) Port letter of the chip select pin,
+ *                                  for instance C.
+ *                   pin        (I) Chip select pin number, for instance PC5.
+ *                   mode       (I) One of the stdUSPI_MODEn, optionally
+ *                                  with stdUSPI_LSB_FIRST.
+ *                   frequency  (I) Maximal SCK frequency in Hz.
+ */
+void stdInstantiateUSpiDevice( String name, String port, uInt8 pin, uInt8 mode, uInt32 frequency );
+
+#define stdInstantiateUSpiDevice(name,port,pin,mode,frequency) \
+           struct stdUSpiDeviceRec name = { stdBUS_DEVICE(port,pin,mode,frequency), 0 }
+
+/*-------------------------------- Functions --------------------------------*/
+
+/*
+ * Function        : Power up USART0 in Master SPI Mode.
+ */
+void stdUSpiInit();
+
+
+/*
+ * Function        : Make the chip select pin of a device an output,
+ *                   and deselect the device.
+ * Parameters      : device     (I) Device to set up.
+ */
+void stdUSpiAttach( stdUSpiDevice_t device );
+
+#define stdUSpiAttach(device)   stdBusAttach(&(device)->bus)
+
+
+/*
+ * Function        : Exchange bytes with a device, with the device
+ *                   selected during the whole transfer. The calling
+ *                   thread blocks until the transfer is complete,
+ *                   unless it is so short that waiting for it is
+ *                   cheaper than a context switch.
+ * Parameters      : device     (I) Device to exchange with.
+ *                   tx         (I) Bytes to send, or Null for sending 0xff.
+ *                   rx         (O) Received bytes, or Null for discarding them.
+ *                   size       (I) Number of bytes.
+ */
+void stdUSpiTransfer( stdUSpiDevice_t device, const uInt8 *tx, uInt8 *rx, uInt16 size );
+
+
+/*
+ * Function        : Power down USART0.
+ */
+void stdUSpiTerm();
+
+#endif
@@ -6,8 +6,17 @@
 
 void uart_init();
 void uart_write(char x);
+void uart_write_chars(const char *x, uint8_t length);
+void uart_format_P(const char *format, ...);
+void uart_flush();
+int16_t uart_set_baud(uint32_t baud);
+int16_t uart_baud_error();
 char uart_read();
+int  uart_try_read();
+int  uart_read_timeout(uint16_t timeout);
+void uart_rx_errors(uint16_t *overruns, uint16_t *frameErrors);
 
 void uart_activate( char on );
+void uart_stdio();
 
 #endif
@@ -9,53 +9,238 @@
 #include <avr/io.h>
 #include <inttypes.h>
 #include "uart.h"
+#include "stdFormat.h"
 
-static stdThread_t uartTXWaiter;
-static stdThread_t uartRXWaiter;
+// baud rate set by uart_init; slower clocks
+// cannot generate 115200bps accurately enough
+#ifndef UART_BAUD
+#if F_CPU >= 10000000UL
+#define UART_BAUD   115200UL
+#else
+#define UART_BAUD    38400UL
+#endif
+#endif
+
+// UBRR0+1 for a clock, rounded, in normal (16) or
+// double speed (8) mode; for 115200bps with a 
+// 14.7456MHz clock this gives 8 in normal mode
+#define UART_DIV(freq,m)      (((freq) + (m)*UART_BAUD/2) / ((m)*UART_BAUD))
+#define UART_ACTUAL(freq,m)   ((freq) / ((m)*UART_DIV(freq,m)))
+#define UART_OFF(freq,m)      ( UART_DIV(freq,m) == 0 \
+                             || UART_ACTUAL(freq,m)*1000 < UART_BAUD*980 \
+                             || UART_ACTUAL(freq,m)*1000 > UART_BAUD*1020 )
+
+#if UART_DIV(F_CPU,8) == 0
+  #warning "UART_BAUD unattainable at F_CPU"
+#elif UART_OFF(F_CPU,16) && UART_OFF(F_CPU,8)
+  #warning "UART_BAUD deviates more than 2% at F_CPU"
+#endif
+
+// transmit ring buffer size, must be a power of two;
+// at most 128, since a full ring must be told apart from
+// an empty one in the difference of the 8 bit indices
+#ifndef UART_TX_BUFFER
+#define UART_TX_BUFFER   32
+#endif
+
+#if UART_TX_BUFFER > 128 || (UART_TX_BUFFER & (UART_TX_BUFFER-1))
+  #error "UART_TX_BUFFER must be a power of two, at most 128"
+#endif
+
+#define TX_MASK   (UART_TX_BUFFER-1)
+
+// receive ring buffer size, same restrictions
+#ifndef UART_RX_BUFFER
+#define UART_RX_BUFFER   32
+#endif
+
+#if UART_RX_BUFFER > 128 || (UART_RX_BUFFER & (UART_RX_BUFFER-1))
+  #error "UART_RX_BUFFER must be a power of two, at most 128"
+#endif
+
+#define RX_MASK   (UART_RX_BUFFER-1)
+
+static stdInstantiateSignal( uartTXReady );
+static stdInstantiateSignal( uartRXReady );
+
+// bytes are added at txHead by threads, and
+// sent from txTail by the UDRE interrupt; a
+// thread that needs the buffer to drain down to
+// txWakeLevel sets txWaiting
+static volatile uint8_t  txBuffer[UART_TX_BUFFER];
+static volatile uint8_t  txHead, txTail;
+static volatile uint8_t  txWakeLevel;
+static volatile char     txWaiting;
+static volatile char     txStarted;
+
+// bytes are added at rxHead by the always enabled
+// RX interrupt, and taken from rxTail by threads;
+// a thread waiting for data sets rxWaiting
+static volatile uint8_t  rxBuffer[UART_RX_BUFFER];
+static volatile uint8_t  rxHead, rxTail;
+static volatile char     rxWaiting;
+static volatile uint16_t rxOverruns;
+static volatile uint16_t rxFrameErrors;
 
 
 static void uartTXHandler()
 { 
-    UCSR0B &= ~(1<<UDRIE0);
-    
-    if (uartTXWaiter) {
-        stdThreadResume(uartTXWaiter);
-        uartTXWaiter = NULL;
-    }
+    stdSignalRaise(&uartTXReady);
+}
+
+// wait until at most level bytes are left in the
+// transmit buffer; called with interrupts disabled
+static void uart_drain(uint8_t level)
+{
+  while ( (uint8_t)(txHead - txTail) > level ) {
+      if (!txWaiting || level < txWakeLevel) {
+          txWakeLevel = level;
+      }
+      txWaiting = 1;
+      stdSignalReset(&uartTXReady);
+      stdXEnableInterrupts();
+      stdSignalWait(&uartTXReady, stdFOREVER);
+      stdXDisableInterrupts();
+  }
 }
 
 static void uartRXHandler()
 { 
-    UCSR0B &= ~(1<<RXCIE0);
-    
-    if (uartRXWaiter) {
-        stdThreadResume(uartRXWaiter);
-        uartRXWaiter = NULL;
-    }
+    stdSignalRaise(&uartRXReady);
 }
 
 
+// queue a byte for transmission, blocking only 
+// while the transmit buffer is full; a writer that
+// blocks is woken when the buffer is half empty
 void uart_write(char x) 
 {
-  if ( (UCSR0A & (1<<UDRE0)) == 0 ) {
-      uartTXWaiter = stdCurrentThread;
+  stdXDisableInterrupts();
+
+  if ( (uint8_t)(txHead - txTail) == UART_TX_BUFFER ) {
+      uart_drain(UART_TX_BUFFER/2);
+  }
+
+  txBuffer[txHead++ & TX_MASK] = x;
+  UCSR0B |= (1<<UDRIE0);
+
+  stdXEnableInterrupts();
+}
+
+// queue a number of bytes, copying as many 
+// as fit at a time into the transmit buffer
+void uart_write_chars(const char *x, uint8_t length)
+{
+  stdXDisableInterrupts();
+
+  while (length) {
+      if ( (uint8_t)(txHead - txTail) == UART_TX_BUFFER ) {
+          uart_drain(UART_TX_BUFFER/2);
+      }
+
+      while (length && (uint8_t)(txHead - txTail) != UART_TX_BUFFER) {
+          txBuffer[txHead++ & TX_MASK] = *x++;
+          length--;
+      }
+
       UCSR0B |= (1<<UDRIE0);
-      stdThreadSuspendSelf();
   }
 
-  UDR0 = x;
+  stdXEnableInterrupts();
+}
+
+static void uart_sink(Pointer sink, const char *x, uint8_t length)
+{
+  uart_write_chars(x, length);
+}
+
+// formatted output, see stdFormat.h
+void uart_format_P(PGM_P format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  stdFormatV_P(uart_sink, Null, format, args);
+  va_end(args);
+}
+
+// wait until all queued bytes have been sent
+void uart_flush()
+{
+  stdXDisableInterrupts();
+  uart_drain(0);
+  stdXEnableInterrupts();
+
+  // the last byte leaves the shift register 
+  // within one character time
+  if (txStarted) {
+      while ( (UCSR0A & (1<<TXC0)) == 0 ) {}
+  }
+}
+
+// next received byte, waiting at most timeout 
+// kernel ticks (or stdFOREVER); -1 on timeout
+int uart_read_timeout(uint16_t timeout)
+{
+  uint16_t start = stdTime();
+  uint8_t  x;
+
+  while (1) {
+      uint16_t elapsed = stdTime() - start;
+
+      stdXDisableInterrupts();
+
+      if (rxHead != rxTail) {
+          break;
+      }
+
+      if (timeout != stdFOREVER && elapsed >= timeout) {
+          stdXEnableInterrupts();
+          return -1;
+      }
+
+      rxWaiting = 1;
+      stdSignalReset(&uartRXReady);
+      stdXEnableInterrupts();
+
+      stdSignalWait(&uartRXReady, timeout == stdFOREVER ? stdFOREVER : timeout - elapsed);
+  }
+
+  x = rxBuffer[rxTail++ & RX_MASK];
+  stdXEnableInterrupts();
+
+  return x;
 }
 
+// next received byte, waiting for it
 char uart_read() 
 {
-  while ( (UCSR0A & (1<<RXC0)) == 0 ) {
-      uartRXWaiter = stdCurrentThread;
-  
-      UCSR0B |= (1<<RXCIE0);
-      stdThreadSuspendSelf();
+  return uart_read_timeout(stdFOREVER);
+}
+
+// next received byte, or -1 when none is buffered
+int uart_try_read()
+{
+  int x = -1;
+
+  stdXDisableInterrupts();
+  if (rxHead != rxTail) {
+      x = rxBuffer[rxTail++ & RX_MASK];
   }
+  stdXEnableInterrupts();
 
-  return UDR0;
+  return x;
+}
+
+// number of bytes lost since uart_init, because 
+// the buffer or UDR0 overflowed, and because of
+// framing errors
+void uart_rx_errors(uint16_t *overruns, uint16_t *frameErrors)
+{
+  stdXDisableInterrupts();
+  *overruns    = rxOverruns;
+  *frameErrors = rxFrameErrors;
+  stdXEnableInterrupts();
 }
 
 
@@ -73,10 +258,52 @@ void uart_activate( char on )
 
 
 SIGNAL(USART_UDRE_vect)
-{ stdRunISR(uartTXHandler); }
+{
+  uint8_t left;
+
+  if (txHead != txTail) {
+      // clear TXC0, writing zero to the error flags
+      UCSR0A    = (UCSR0A & ((1<<U2X0)|(1<<MPCM0))) | (1<<TXC0);
+      UDR0      = txBuffer[txTail++ & TX_MASK];
+      txStarted = 1;
+  }
+
+  left = txHead - txTail;
+
+  if (left == 0) {
+      UCSR0B &= ~(1<<UDRIE0);
+  }
+
+  if (txWaiting && left <= txWakeLevel) {
+      txWaiting = 0;
+      stdRunISR(uartTXHandler);
+  }
+}
 
 SIGNAL(USART_RX_vect)
-{ stdRunISR(uartRXHandler); }
+{
+  uint8_t status = UCSR0A;
+  uint8_t x      = UDR0;
+
+  if (status & (1<<FE0)) {
+      rxFrameErrors++;
+  } else {
+      if (status & (1<<DOR0)) {
+          rxOverruns++;
+      }
+
+      if ( (uint8_t)(rxHead - rxTail) == UART_RX_BUFFER ) {
+          rxOverruns++;
+      } else {
+          rxBuffer[rxHead++ & RX_MASK] = x;
+      }
+  }
+
+  if (rxWaiting) {
+      rxWaiting = 0;
+      stdRunISR(uartRXHandler);
+  }
+}
 
 
 
@@ -90,20 +317,117 @@ SIGNAL(USART_RX_vect)
        return x;
      }
 
+static uint32_t uartBaud = UART_BAUD;
+
+// deviation of the rate obtained at the 
+// current CPU clock, see uart_baud_error
+static int16_t  uartError;
+
+// set the divisor for baud at clock freq, using double
+// speed only when that is more accurate; returns the
+// deviation from baud in tenths of a percent
+static int16_t uart_divisor(uint32_t freq, uint32_t baud) {
+  uint16_t bestDiv   = 1;
+  char     bestU2X   = 0;
+  int32_t  bestError = INT16_MAX;
+  char     u2x;
+
+  for (u2x = 0; u2x <= 1; u2x++) {
+      uint32_t scale  = (u2x ? 8 : 16) * baud;
+      uint32_t div    = (freq + scale/2) / scale;
+      int32_t  error;
+
+      if (div == 0)    { div = 1;    }
+      if (div > 4096)  { div = 4096; }
+
+      error = (int32_t)(freq / ((u2x ? 8 : 16) * div)) - (int32_t)baud;
+
+      // beyond 12.5% is useless anyway, and
+      // keeps the computation within 32 bits
+      if      (error >  (int32_t)(baud/8)) { error = INT16_MAX;  }
+      else if (error < -(int32_t)(baud/8)) { error = -INT16_MAX; }
+      else                                 { error = error * 1000 / (int32_t)baud; }
+
+      if ( (error < 0 ? -error : error) < (bestError < 0 ? -bestError : bestError) ) {
+          bestDiv   = div;
+          bestU2X   = u2x;
+          bestError = error;
+      }
+  }
+
+  UBRR0H = (bestDiv - 1) >> 8;
+  UBRR0L = (bestDiv - 1) & 0xff;
+
+  // writing zero to the flags leaves TXC0 alone
+  UCSR0A = (UCSR0A & (1<<MPCM0)) | (bestU2X ? (1<<U2X0) : 0);
+
+  uartError = bestError;
+
+  return bestError;
+}
+
+// follow CPU clock scaling; the baud rate
+// can only be approximated at low clock speeds,
+// which uart_baud_error reports
+static void uart_clock(uint32_t freq) {
+  uart_divisor(freq, uartBaud);
+}
+
+// deviation of the baud rate at the current CPU 
+// clock in tenths of a percent; clock hooks cannot
+// refuse a clock change, so check this after 
+// stdClockSetDivider, and restore the divider or
+// boost the clock around output when it exceeds
+// about 20 (for instance, 38400bps at 1MHz)
+int16_t uart_baud_error() {
+  int16_t error;
+
+  stdXDisableInterrupts();
+  error = uartError;
+  stdXEnableInterrupts();
+
+  return error;
+}
+
+// change the baud rate after sending what is
+// buffered; returns the deviation of the obtained
+// rate in tenths of a percent, which should stay 
+// within about 20 on both ends of the line
+int16_t uart_set_baud(uint32_t baud) {
+  int16_t error;
+
+  uart_flush();
+
+  stdSchedulerLock();
+  {
+      uartBaud = baud;
+      error    = uart_divisor(stdClockFrequency(), baud);
+  }
+  stdSchedulerUnlock();
+
+  return error;
+}
+
+static stdInstantiateClockHook( uartClock, uart_clock );
+
 void uart_init() {
   // power up uart:
   PRR &= ~(1<<PRUSART0);
     
   // set baud rate
-  UBRR0H = 0;
-  UBRR0L = 7;   // for 115200bps with 14.7456MHz clock
-  // enable uart RX and TX
-  
-  UCSR0B = (1<<RXEN0)|(1<<TXEN0);
+  uart_set_baud(UART_BAUD);
+  stdClockHookAdd(&uartClock);
+  // enable uart RX and TX, with the 
+  // receive interrupt always armed
+  rxHead = rxTail = 0;
+  UCSR0B = (1<<RXEN0)|(1<<TXEN0)|(1<<RXCIE0);
   // set 8N1 frame format
   UCSR0C = (1<<UCSZ01)|(1<<UCSZ00);
+}
 
-  // set up STDIO handlers so you can use printf, etc
+// set up STDIO handlers so you can use printf, etc;
+// this links in avr-libc stdio, which uart_format_P avoids
+void uart_stdio() {
   fdevopen(&uart_putchar, &uart_getchar);
 }
 
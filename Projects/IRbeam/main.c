@@ -107,16 +107,27 @@ static OperationMode  readMode()
     }
 }
 
+/* ------------------------------ Beam Events ------------------------------ */
+
+       /*
+        * Events set by the interrupt handlers 
+        * that drive the beam checking logic:
+        */
+        #define EV_AC_TRIGGERED     0x01      // Analog comparator saw falling edge
+        #define EV_STROBE0_DONE     0x02      // Beam strobe on TIMER0 completed
+        #define EV_STROBE1_DONE     0x04      // Beam strobe on TIMER1 completed
+
+        static stdInstantiateEvents( beamEvents, 0 );
+
 /* --------------- Analog Comparator from TSOM 38238 on AIN1 --------------- */
 
-        static Bool    acTriggered;
         static uInt16  acTriggeredTime;
         void acOn()
         {
             // Configure analog comparator
             // to compare AIN1 with bandgap voltage:
             //
-            acTriggered = False;
+            stdEventsClear(&beamEvents, EV_AC_TRIGGERED);
             
             DDRD   &= ~((1<<PD6)|(1<<PD7));        // Define AIN0 as input
             PORTD  &= ~((1<<PD6)|(1<<PD7));        // .. and disable pullup
@@ -127,14 +138,17 @@ static OperationMode  readMode()
             DIDR1  |=   (1<<AIN0D)|(1<<AIN1D);     // Disable digital input on AIN01
         }
 
-        SIGNAL(ANALOG_COMP_vect)
+        static void acHandler()
         {
             ACSR = (1<<ACD);                      // disable AC
             
-            acTriggered     = True;
             acTriggeredTime = stdTime();
+            stdEventsSet(&beamEvents, EV_AC_TRIGGERED);
         }
 
+        SIGNAL(ANALOG_COMP_vect)
+        { stdRunISR(acHandler); }
+
 /* -------------------- Send fixed amount of IR pulses --------------------- */
 
        /*
@@ -152,17 +166,16 @@ static OperationMode  readMode()
         */
             typedef struct {
                 uint16_t     strobeDecrement;
-                stdThread_t  strobeThread;
                 Bool         isBeamStrobe;
             } StrobeInfoRec;
             
             static StrobeInfoRec  strobeInfo[2];
             
                 static void wakeStrober0()
-                { stdThreadResume(strobeInfo[0].strobeThread); }
+                { stdEventsSet(&beamEvents, EV_STROBE0_DONE); }
 
                 static void wakeStrober1()
-                { stdThreadResume(strobeInfo[1].strobeThread); }
+                { stdEventsSet(&beamEvents, EV_STROBE1_DONE); }
 
 
             SIGNAL(TIMER0_COMPA_vect)
@@ -204,13 +217,14 @@ static OperationMode  readMode()
         static void sendBeamStrobe( IRPulseOutput pin, DutyCycle duty, uInt16 pulseCount )
         {
             uInt8 pindex = (pin&2)>>1;
+            uInt8 done   = pindex ? EV_STROBE1_DONE : EV_STROBE0_DONE;
 
             strobeInfo[pindex].isBeamStrobe    = True;
             strobeInfo[pindex].strobeDecrement = pulseCount;
-            strobeInfo[pindex].strobeThread    = stdCurrentThread;
 
+            stdEventsClear(&beamEvents, done);
             IRPulseStart(pin,duty,True,True);
-            stdThreadSuspendSelf();
+            stdEventsWait(&beamEvents, done, stdEVENTS_ANY|stdEVENTS_CLEAR, stdFOREVER);
             IRPulseStop(pin);
         }
 
@@ -322,7 +336,7 @@ static OperationMode  readMode()
 
         acOn();
         sendBeamStrobe(IR_OC1B,DC_12, 8);
-        result = !acTriggered;
+        result = !(stdEventsGet(&beamEvents) & EV_AC_TRIGGERED);
 
         return result;
     }
@@ -372,9 +386,12 @@ static OperationMode  readMode()
             acOn();
         }
 
-        stdThreadSleep( 2 * PULSE_DELTA );
-
-        lockedIn = acTriggered;
+       /*
+        * Wait for the beacon's strobe during a window 
+        * around its expected arrival time, but return as 
+        * soon as the analog comparator sees it:
+        */
+        lockedIn = stdEventsWait( &beamEvents, EV_AC_TRIGGERED, stdEVENTS_ANY, 2 * PULSE_DELTA ) != 0;
 
         if (lockedIn) {
             lastTriggeredTime = acTriggeredTime;
@@ -20,26 +20,27 @@
 /*
  * Forward declarations:
  */
-static void displayF();
+static void displayF( Pointer arg );
 
 
 /*
  * Static global threads creation.
- * All threads are initially runnable, and linked into the run queue.
- * 80 bytes stack each seems to be sufficient, except for mainThread, 
- * which is running on the program's initial stack
+ * The main thread is running on the program's initial stack.
  *
- * Note that we have two threads here: the main 'processing' thread
- * and the 2-digit LED display driver thread that is responsible for
- * displaying the numbers set by the main thread.
- * We chose here to give LED display the lowest priority (= higher value),
- * which sacrifices display for processing whenever the processor
- * gets overloaded:
+ * Next to the main 'processing' thread, we have the 2-digit
+ * LED display driver, which is responsible for displaying 
+ * the numbers set by the main thread. It is a periodic 
+ * run-to-completion task that never blocks, so that it 
+ * does not need a thread of its own but only the few bytes
+ * of stack of a task runner. The display gets the higher 
+ * priority, to avoid flicker:
  */
-                  //  NAME        STACK SIZE   FUNCTION     PRIORITY     RUN COUNT    PREVIOUS
-                  //  ==========  ==========   ===========  ========     =========    ===========
-stdInstantiateThread( display,            80,  displayF,          10,            1,   Null      );
-stdInstantiateThread( mainThread,          1,  Null,               0,            1,   &display  );
+                      //  NAME        STACK SIZE   FUNCTION     PRIORITY     RUN COUNT    PREVIOUS
+                      //  ==========  ==========   ===========  ========     =========    ===========
+stdInstantiateThread    ( mainThread,          1,  Null,               0,            1,   Null      );
+
+stdInstantiateTaskRunner( tasks,              64 );
+stdInstantiateTask      ( display,                 displayF,   Null,  10,                 &tasks    );
 
 /*
  * Run Queue Initialization:
@@ -93,8 +94,8 @@ static void ledSetup()
  * i.e. same digit left and right.
  *
  * Also note that this function is a helper function
- * used by the display thread. By rapidly switching
- * between the left and right digit this thread makes
+ * used by the display task. By rapidly switching
+ * between the left and right digit this task makes
  * it appear as if both digits show a, possibly different,
  * value at the same time.
  */
@@ -107,7 +108,7 @@ static void setDigit( Bool left, uint8_t m )
 
 /*
  * The segment mask left and right values 
- * to be displayed by the display thread.
+ * to be displayed by the display task.
  * These values are 'computed' by the different
  * display functions:  ledSetNumber or ledSetRandomPattern,
  * whichever is currently chosen in the main() loop.
@@ -115,23 +116,29 @@ static void setDigit( Bool left, uint8_t m )
 volatile int mask_left, mask_right;
 
 
-static void displayF()
+static void displayF( Pointer arg )
 {
-    while (True) {
-        setDigit(True,  mask_left);
-        stdThreadSleep( stdSECOND / 64 );
+    static Bool left;
 
-        setDigit(False, mask_right);
-        stdThreadSleep( stdSECOND / 64 );
-    }
+    left= !left;
+
+    setDigit(left, left ? mask_left : mask_right);
 }
 
 /* -------------------- Setting Full Number for Display -------------------- */
 
 static void ledSetNumber( uint8_t n )
 {
-    mask_left  = ~digitMask[ (n/10)%10 ];  // complement of digit mask, because
-    mask_right = ~digitMask[ (n/ 1)%10 ];  //     we have a common anode display
+   /*
+    * Keep the display task from showing
+    * a half updated number:
+    */
+    stdSchedulerLock();
+    {
+        mask_left  = ~digitMask[ (n/10)%10 ];  // complement of digit mask, because
+        mask_right = ~digitMask[ (n/ 1)%10 ];  //     we have a common anode display
+    }
+    stdSchedulerUnlock();
 }
 
 /* -------------------------- ADC from LM34 on PC0 ------------------------- */
@@ -156,7 +163,10 @@ int main()
     ledSetup();
  
     // Initialize the adc
-    adcSetup();
+    adcSetup(0);
+
+    // Start refreshing the display
+    stdTaskStartTimer(&display, 0, stdSECOND / 64);
          
    /*
     * Demo program, counting on the
@@ -4,6 +4,7 @@
 #include "uart.h"
 
 #include "stdThreads.h" 
+#include "stdSpi.h"
 
 
 stdInstantiateThread( mainThread, 1,  Null, 10, 1, NULL );
@@ -22,25 +23,30 @@ ThreadPrioQ_t  stdRunQ            = &mainThread;
 #define SRCLK  (1<<PB5)
 
 
-static void update()
-{
-    PORTC |=  RCLK;
-    PORTC &= ~RCLK;
-}
-
-
-
 #define USE_SPI
 
 
 #ifdef USE_SPI
+   /*
+    * RCLK serves as chip select: the
+    * register is latched when it goes high
+    * at the end of the transfer:
+    */
+    stdInstantiateSpiDevice( shifter, C, PC0, stdSPI_MODE2, 2000000UL );
+
     static void display( uInt16 n )
     {
-        SPDR = n;
-        while (!(SPSR & (1<<SPIF))) {}
-        update();
+        uInt8 byte= n;
+
+        stdSpiTransfer( &shifter, &byte, Null, 1 );
     }
 #else
+    static void update()
+    {
+        PORTC |=  RCLK;
+        PORTC &= ~RCLK;
+    }
+
     static void shift_bit(Bool i)
     {
         if (i) { PORTB |=  SER; }
@@ -78,22 +84,8 @@ int main()
     DDRC |= RCLK | BLINK;
     
 #ifdef USE_SPI
-   /*
-    * Wake up SPI from sleep mode,
-    * and define SPI  MOSI and CLK pins as output.
-    * (We named them SER and SRCLK here).
-    * Note (atmega manual, Section 18.3.2),
-    * SS must either be output, or held high.
-    * So we set it to output:
-    */
-    PRR  &= ~(1<<PRSPI);
-    DDRB |= (SER | SRCLK | SS);
-
-   /*
-    * Enable SPI, Master, set clock rate fck/4,
-    * SRCLK lo-hi-lo:
-    */
-    SPCR = (1<<SPE) | (1<<MSTR) | (1<<CPOL);
+    stdSpiInit();
+    stdSpiAttach(&shifter);
 
 #else
    /*
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#
+#
+#         Decoder for the telemetry frames sent by stdTelemetry
+#         (see Lib/threads/stdTelemetry.h), writing CSV.
+#
+#         Record types are described on the command line as
+#
+#             TYPE:NAME:FORMAT:FIELD,FIELD,...
+#
+#         with FORMAT in Python struct notation, without byte order.
+#         For instance, for Demo/acousticPing:
+#
+#             telemetry.py --port /dev/ttyUSB0 --baud 38400 --record 1:ping:IB:delay,scaled
+#
+#         --baud must match UART_BAUD of the build (see uart_modified.c),
+#         which defaults to 115200 for clocks of 10 MHz and up, and to
+#         38400 below that, as in the default 8 MHz build; this is also
+#         the default here.
+#
+#         Without --output, all records are written to stdout as
+#         NAME,SEQUENCE,FIELD,...; with --output PREFIX, each record type
+#         gets its own file PREFIX_NAME.csv with a header line.
+#         Lost frames (sequence gaps) and corrupt frames are reported
+#         on stderr.
+#
+
+import argparse
+import binascii
+import csv
+import struct
+import sys
+import time
+
+
+def cobs_decode(data):
+    out  = bytearray()
+    i    = 0
+
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS code")
+        out += data[i+1 : i+code]
+        i   += code
+        if code < 0xff and i < len(data):
+            out.append(0)
+
+    return bytes(out)
+
+
+def frames(stream):
+    """Yield the COBS encoded contents of zero terminated frames."""
+    pending = bytearray()
+
+    while True:
+        chunk = stream.read(1) if hasattr(stream, "in_waiting") else stream.read(4096)
+        if not chunk:
+            return
+
+        if hasattr(stream, "in_waiting") and stream.in_waiting:
+            chunk += stream.read(stream.in_waiting)
+
+        for b in chunk:
+            if b == 0:
+                if pending:
+                    yield bytes(pending)
+                pending = bytearray()
+            else:
+                pending.append(b)
+
+
+class Record:
+    def __init__(self, spec):
+        type_, self.name, fmt, fields = spec.split(":", 3)
+        self.type   = int(type_, 0)
+        self.struct = struct.Struct("<" + fmt)
+        self.fields = fields.split(",") if fields else []
+
+        if len(self.fields) != len(self.struct.unpack(bytes(self.struct.size))):
+            raise ValueError("field names do not match format in " + spec)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode stdTelemetry frames into CSV")
+    parser.add_argument("--port",   help="serial port (needs pyserial)")
+    parser.add_argument("--baud",   type=int, default=38400,
+                        help="UART_BAUD of the build (default 38400)")
+    parser.add_argument("--input",  help="file with captured bytes, - for stdin")
+    parser.add_argument("--output", help="prefix of per record CSV files")
+    parser.add_argument("--record", action="append", default=[], type=Record,
+                        metavar="TYPE:NAME:FORMAT:FIELDS")
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, args.baud)
+    elif args.input and args.input != "-":
+        stream = open(args.input, "rb")
+    else:
+        stream = sys.stdin.buffer
+
+    records = { r.type : r for r in args.record }
+    writers = {}
+    files   = []
+
+    def writer(record):
+        if record.type not in writers:
+            if args.output:
+                f = open("%s_%s.csv" % (args.output, record.name), "w", newline="")
+                files.append(f)
+                w = csv.writer(f)
+                w.writerow(["time", "sequence"] + record.fields)
+            else:
+                w = csv.writer(sys.stdout)
+            writers[record.type] = w
+        return writers[record.type]
+
+    last, lost, corrupt, unknown = None, 0, 0, 0
+
+    try:
+        for encoded in frames(stream):
+            try:
+                frame = cobs_decode(encoded)
+            except ValueError:
+                frame = b""
+
+            if len(frame) < 4 or binascii.crc_hqx(frame[:-2], 0xffff) != struct.unpack("<H", frame[-2:])[0]:
+                corrupt += 1
+                print("corrupt frame", file=sys.stderr)
+                continue
+
+            sequence, type_, body = frame[0], frame[1], frame[2:-2]
+
+            if last is not None and (sequence - last - 1) & 0xff:
+                gap   = (sequence - last - 1) & 0xff
+                lost += gap
+                print("lost %d frame(s) before %d" % (gap, sequence), file=sys.stderr)
+            last = sequence
+
+            record = records.get(type_)
+            if record is None or len(body) != record.struct.size:
+                unknown += 1
+                print("unknown record type %d, size %d" % (type_, len(body)), file=sys.stderr)
+                continue
+
+            values = list(record.struct.unpack(body))
+
+            if args.output:
+                writer(record).writerow(["%.3f" % time.time(), sequence] + values)
+            else:
+                writer(record).writerow([record.name, sequence] + values)
+                sys.stdout.flush()
+
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for f in files:
+            f.close()
+        print("lost %d, corrupt %d, unknown %d" % (lost, corrupt, unknown), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()